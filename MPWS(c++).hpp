@@ -134,8 +134,8 @@
 	struct Color {
 		u8 r,g,b,a;
 		
-		Color(u8 r, u8 g, u8 b):r(r), g(g), b(g) {a = 255;}
-		Color(u8 r, u8 g, u8 b, u8 a):r(r), g(g), b(g), a(a) {}
+		Color(u8 r, u8 g, u8 b):r(r), g(g), b(b) {a = 255;}
+		Color(u8 r, u8 g, u8 b, u8 a):r(r), g(g), b(b), a(a) {}
 	}; typedef struct Color Color;
 	
 	enum SHAPE {
@@ -148,6 +148,11 @@
 			MPWS_POLYGON,
 			MPWS_FILL_POLYGON};
 
+	enum GLYPH_RASTERIZER {
+			MPWS_RASTER_AREA,
+			MPWS_RASTER_SCANLINE,
+			MPWS_RASTER_SDF};
+
 	enum KeyCharacter {
 		KEY_UNKNOWN,
 		Key_A, Key_B, Key_C,
@@ -168,6 +173,12 @@
 		Key_DOWN, Key_CTRL, Key_SHIFT, Key_ALT
 	};
 	
+	enum MouseButton {
+		MOUSE_UNKNOWN,
+		Mouse_LEFT, Mouse_MIDDLE, Mouse_RIGHT,
+		Mouse_X1, Mouse_X2 // back and forward side buttons
+	};
+	
 	i32 cmp_floats(const void *a, const void *b) {
 		f32 f_a = *(f32 *)a;
 		f32 f_b = *(f32 *)b;
@@ -185,11 +196,47 @@
 #ifdef MPWS_IMPLEMENTATION
 	
 	#include <iostream>
+	#include <cstdint>
 	#include <thread>
 	#include <atomic>
 	#include <vector>
 	#include <cstring>
+	#include <cmath>
+	#include <algorithm>
 	#include <unordered_map>
+	#include <list>
+	#include <string>
+	#include <memory>
+	#include <mutex>
+	#include <condition_variable>
+	#include <future>
+	#include <chrono>
+	#include <stdexcept>
+	#include <new>
+	#if defined(UTIL_WIN32)
+		#ifndef NOMINMAX
+			#define NOMINMAX
+		#endif
+		#include <windows.h>
+		#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+			#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+		#endif
+	#else
+		#include <fcntl.h>
+		#include <unistd.h>
+		#include <sys/mman.h>
+		#include <sys/stat.h>
+	#endif
+//simd
+	#ifndef MPWS_NO_SIMD
+		#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+			#define MPWS_SSE2
+			#include <emmintrin.h>
+		#elif defined(__aarch64__) || defined(_M_ARM64)
+			#define MPWS_NEON
+			#include <arm_neon.h>
+		#endif
+	#endif
 //file reading
 	#define READ_BE16(mem) ((((u8*)(mem))[0] << 8) | (((u8*)(mem))[1]))
 	#define READ_BE32(mem) ((((u8*)(mem))[0] << 24) | (((u8*)(mem))[1] << 16) | (((u8*)(mem))[2] << 8) | (((u8*)(mem))[3]))
@@ -204,7 +251,49 @@
 	#define HEAD_TAG FONT_TAG('h', 'e', 'a', 'd')
 	#define CMAP_TAG FONT_TAG('c', 'm', 'a', 'p')
 	#define OS2_TAG FONT_TAG('O', 'S', '/', '2')
+	#define HHEA_TAG FONT_TAG('h', 'h', 'e', 'a')
+	#define HMTX_TAG FONT_TAG('h', 'm', 't', 'x')
+	#define KERN_TAG FONT_TAG('k', 'e', 'r', 'n')
 //structs
+	// read only window into big endian font data, every read is bounds checked
+	// and anything past the end reads as 0 so broken fonts can not walk off the file
+	struct BEView {
+		const u8* data;
+		u32 size;
+		
+		BEView(): data(nullptr), size(0) {}
+		BEView(const u8* data, u32 size): data(data), size(size) {}
+		
+		bool valid() const {return data != nullptr;}
+		bool has(u32 offset, u32 len) const {return offset <= size && len <= size - offset;}
+		
+		u8 be8(u32 offset) const {return has(offset, 1) ? data[offset] : 0;}
+		u16 be16(u32 offset) const {return has(offset, 2) ? (u16)READ_BE16(data + offset) : 0;}
+		u32 be32(u32 offset) const {return has(offset, 4) ? (u32)READ_BE32(data + offset) : 0;}
+		i16 bei16(u32 offset) const {return (i16)be16(offset);}
+		
+		// clamped to this view, an offset past the end gives an empty view
+		BEView sub(u32 offset, u32 len) const {
+			if(offset > size) return BEView();
+			if(len > size - offset) len = size - offset;
+			return BEView(data + offset, len);
+		}
+		BEView sub(u32 offset) const {return sub(offset, size);}
+	}; typedef struct BEView BEView;
+	
+	// sequential reads over a BEView, the view version of READ_BE16_MOVE
+	struct BECursor {
+		BEView view;
+		u32 pos;
+		
+		BECursor(BEView view): view(view), pos(0) {}
+		
+		u8 next8() {u8 v = view.be8(pos); pos += 1; return v;}
+		u16 next16() {u16 v = view.be16(pos); pos += 2; return v;}
+		u32 next32() {u32 v = view.be32(pos); pos += 4; return v;}
+		void skip(u32 n) {pos += n;}
+	}; typedef struct BECursor BECursor;
+
 	typedef struct {
 		u32	scaler_type;
 		u16	numTables;
@@ -219,26 +308,16 @@
 		u32 offset;
 	} cmap_encoding_subtable;
 
+	// the format 4 arrays stay inside of the font file,
+	// the array members are byte offsets into table
 	typedef struct {
-		u16 version;
-		u16 numberSubtables;
-		cmap_encoding_subtable* subtables;
-	} cmap;
-
-	typedef struct {
-		u16  format;
-	 	u16  length;
-	 	u16  language;
-	 	u16  segCountX2;
-	 	u16  searchRange;
-	 	u16  entrySelector;
-	 	u16  rangeShift;
-		u16  reservedPad;
-		u16  *endCode;
-		u16  *startCode;
-		u16  *idDelta;
-		u16  *idRangeOffset;
-		u16  *glyphIdArray;
+		BEView table;
+		u16  segCountX2;
+		u32  endCode;
+		u32  startCode;
+		u32  idDelta;
+		u32  idRangeOffset;
+		u32  glyphIdArray;
 	} format4;
 
 	typedef struct {
@@ -251,15 +330,25 @@
 		u32	length;
 	} table_directory;
 
+	// format 12 groups are 12 bytes each: startCharCode, endCharCode, startGlyphID
+	typedef struct {
+		BEView table;
+		u32  numGroups;
+		u32  groups;
+	} format12;
+
 	typedef struct  {
 		offset_subtable off_sub;
-		table_directory* tbl_dir;
-		format4* f4;
-		cmap* cmap;
-		char* glyf;
-		char* loca;
-		char* head;
-		char* os2;
+		format4 f4;
+		format12 f12;
+		BEView cmap;
+		BEView glyf;
+		BEView loca;
+		BEView head;
+		BEView os2;
+		BEView hhea;
+		BEView hmtx;
+		BEView kern;
 	} font_directory; 
 
 	typedef union {
@@ -280,6 +369,16 @@
 		u8 flag;
 	} glyph_flag;
 
+	// flattened contours of a glyph in font units, x and y in separate arrays so a new
+	// size only has to scale them. fine enough for sizes up to pixelsPerEm
+	typedef struct {
+		const f32* x;
+		const f32* y;
+		const i32* ends; // end (exclusive) of every contour
+		u32 count;
+		f32 pixelsPerEm;
+	} flat_outline;
+	
 	typedef struct {
 		u16 numberOfContours;
 		i16 xMin;
@@ -292,7 +391,43 @@
 		i16* xCoordinates;
 		i16* yCoordinates;
 		u16* endPtsOfContours;
+		// built on first use, already set instead of the arrays above when the glyph comes
+		// out of a font cache file
+		const flat_outline* flat;
+		u32 glyphIndex; // to decode the arrays when a cached glyph needs finer points
 	} glyph_outline;
+	
+	// one non horizontal glyph edge as the scanline rasterizer walks it, top is the smaller y
+	typedef struct {
+		f32 yTop;
+		f32 yBottom;
+		f32 xTop;
+		f32 dxdy;
+		f32 x; // crossing with the current sub scanline
+	} glyph_edge;
+	
+	// buffers the glyph rasterizer reuses between glyphs so it only allocates
+	// when a glyph is more complex than every glyph before it
+	typedef struct {
+		std::vector<glyph_edge> edges;  // sorted by yTop
+		std::vector<glyph_edge*> active; // sorted by x on the current sub scanline
+		std::vector<f32> accumulation;   // signed area/cover per pixel for the area rasterizer
+		std::vector<Floint2D> points;    // flattened outline
+		std::vector<i32> contour_ends;   // end (exclusive) of every contour in points
+		std::vector<Line2D> lines;       // rounded outline edges for the scanline rasterizer
+		std::vector<u8> subpixels;       // 3x wide coverage before the lcd filter
+		std::vector<i32> sample_columns; // field column left of every output column when resampling
+		std::vector<f32> sample_weights; // and the weight of the column right of it
+	} raster_scratch;
+	
+	// signed distance field of one glyph at a fixed reference size, 128 is the outline,
+	// every step of 127/spread is one reference pixel further inside (up) or outside (down)
+	typedef struct {
+		i32 width, height;
+		i32 left, bottom; // reference pixels from the pen to the first column and lowest row
+		std::vector<u8> field; // rows bottom up like glyph_bitmap
+	} glyph_sdf;
+	
 
 	typedef struct {
 	    u16 majorVersion, minorVersion;
@@ -317,6 +452,14 @@
 	    /* … */
 	} os2_table;
 
+	typedef struct {
+	    i16 ascender;
+	    i16 descender;
+	    i16 lineGap;
+	    u16 advanceWidthMax;
+	    u16 numberOfHMetrics;
+	} hhea_table;
+
 	#ifndef MPWS_MANUAL_OS_SUPPORT
 		#ifdef UTIL_WIN32
 				#define MPWS_WIN32
@@ -333,7 +476,11 @@
 		EV_KEY_UP,
 		EV_MOVE,
 		EV_RESIZE,
-		EV_CLOSE
+		EV_CLOSE,
+		EV_MOUSE_DOWN,
+		EV_MOUSE_UP,
+		EV_MOUSE_MOVE,
+		EV_MOUSE_WHEEL
 	} EventType;
 	
 	typedef struct {
@@ -344,7 +491,362 @@
 		i32 moveY;
 		i32 resizeWidth;
 		i32 resizeHeight;
+		// pointer events, in window pixels
+		MouseButton button;
+		i32 mouseX;
+		i32 mouseY;
+		f32 wheelX;       // notches, positive to the right
+		f32 wheelY;       // notches, positive away from the user
+		u32 motionCount;  // moves folded into this one
+		u32 time;         // milliseconds on the os input clock
 	} Event;
+	
+	typedef struct {
+		i32 x, y;
+		u32 time;
+	} pointer_sample;
+//geometry buffers
+	// x' = a*x + b*y + tx
+	// y' = c*x + d*y + ty
+	struct Affine2D {
+		f32 a, b, c, d, tx, ty;
+		
+		Affine2D(): a(1), b(0), c(0), d(1), tx(0), ty(0) {}
+		Affine2D(f32 a, f32 b, f32 c, f32 d, f32 tx, f32 ty): a(a), b(b), c(c), d(d), tx(tx), ty(ty) {}
+		
+		static Affine2D translation(f32 x, f32 y) {return Affine2D(1, 0, 0, 1, x, y);}
+		static Affine2D scaling(f32 x, f32 y) {return Affine2D(x, 0, 0, y, 0, 0);}
+		
+		// applies other first, then this
+		Affine2D operator*(const Affine2D& o) const {
+			return Affine2D(a*o.a + b*o.c, a*o.b + b*o.d,
+							c*o.a + d*o.c, c*o.b + d*o.d,
+							a*o.tx + b*o.ty + tx, c*o.tx + d*o.ty + ty);
+		}
+	}; typedef struct Affine2D Affine2D;
+	
+	struct Bounds2D {
+		f32 minX, minY, maxX, maxY;
+	}; typedef struct Bounds2D Bounds2D;
+	
+	// structure of arrays version of Point2D, this is what the batched draw calls take
+	struct PointBuffer2D {
+		std::vector<i32> x, y;
+		
+		i32 size() const {return (i32)x.size();}
+		void resize(i32 n) {x.resize(n); y.resize(n);}
+		void clear() {x.clear(); y.clear();}
+		void push(Point2D p) {x.push_back(p.x); y.push_back(p.y);}
+		Point2D operator[](i32 i) const {return Point2D(x[i], y[i]);}
+	}; typedef struct PointBuffer2D PointBuffer2D;
+	
+	// structure of arrays version of Floint2D, all batch operations process
+	// 4 points per step when SSE2/NEON is available
+	struct FlointBuffer2D {
+		std::vector<f32> x, y;
+		
+		i32 size() const {return (i32)x.size();}
+		void resize(i32 n) {x.resize(n); y.resize(n);}
+		void clear() {x.clear(); y.clear();}
+		void push(Floint2D p) {x.push_back(p.x); y.push_back(p.y);}
+		Floint2D operator[](i32 i) const {return Floint2D(x[i], y[i]);}
+		
+		void transform(const Affine2D& m) {transform(m, *this);}
+		void transform(const Affine2D& m, FlointBuffer2D& out) const {
+			i32 n = size();
+			out.resize(n);
+			const f32* xs = x.data();
+			const f32* ys = y.data();
+			f32* ox = out.x.data();
+			f32* oy = out.y.data();
+			i32 i = 0;
+		#if defined(MPWS_SSE2)
+			__m128 va = _mm_set1_ps(m.a), vb = _mm_set1_ps(m.b), vtx = _mm_set1_ps(m.tx);
+			__m128 vc = _mm_set1_ps(m.c), vd = _mm_set1_ps(m.d), vty = _mm_set1_ps(m.ty);
+			for(; i + 4 <= n; i += 4) {
+				__m128 px = _mm_loadu_ps(xs + i);
+				__m128 py = _mm_loadu_ps(ys + i);
+				_mm_storeu_ps(ox + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(va, px), _mm_mul_ps(vb, py)), vtx));
+				_mm_storeu_ps(oy + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vc, px), _mm_mul_ps(vd, py)), vty));
+			}
+		#elif defined(MPWS_NEON)
+			float32x4_t vtx = vdupq_n_f32(m.tx), vty = vdupq_n_f32(m.ty);
+			for(; i + 4 <= n; i += 4) {
+				float32x4_t px = vld1q_f32(xs + i);
+				float32x4_t py = vld1q_f32(ys + i);
+				vst1q_f32(ox + i, vmlaq_n_f32(vmlaq_n_f32(vtx, px, m.a), py, m.b));
+				vst1q_f32(oy + i, vmlaq_n_f32(vmlaq_n_f32(vty, px, m.c), py, m.d));
+			}
+		#endif
+			for(; i < n; i++) {
+				f32 px = xs[i], py = ys[i];
+				ox[i] = m.a*px + m.b*py + m.tx;
+				oy[i] = m.c*px + m.d*py + m.ty;
+			}
+		}
+		
+		void translate(f32 dx, f32 dy) {transform(Affine2D::translation(dx, dy));}
+		void scale(f32 sx, f32 sy) {transform(Affine2D::scaling(sx, sy));}
+		
+		// round to nearest (ties to even, same as the SIMD conversion)
+		void toPoints(PointBuffer2D& out) const {
+			i32 n = size();
+			out.resize(n);
+			i32 i = 0;
+		#if defined(MPWS_SSE2)
+			for(; i + 4 <= n; i += 4) {
+				_mm_storeu_si128((__m128i*)(out.x.data() + i), _mm_cvtps_epi32(_mm_loadu_ps(x.data() + i)));
+				_mm_storeu_si128((__m128i*)(out.y.data() + i), _mm_cvtps_epi32(_mm_loadu_ps(y.data() + i)));
+			}
+		#elif defined(MPWS_NEON)
+			for(; i + 4 <= n; i += 4) {
+				vst1q_s32(out.x.data() + i, vcvtnq_s32_f32(vld1q_f32(x.data() + i)));
+				vst1q_s32(out.y.data() + i, vcvtnq_s32_f32(vld1q_f32(y.data() + i)));
+			}
+		#endif
+			for(; i < n; i++) {
+				out.x[i] = (i32)lrintf(x[i]);
+				out.y[i] = (i32)lrintf(y[i]);
+			}
+		}
+		
+		// transform and convert in one pass so the floats never get written back
+		void toPoints(const Affine2D& m, PointBuffer2D& out) const {
+			i32 n = size();
+			out.resize(n);
+			const f32* xs = x.data();
+			const f32* ys = y.data();
+			i32* ox = out.x.data();
+			i32* oy = out.y.data();
+			i32 i = 0;
+		#if defined(MPWS_SSE2)
+			__m128 va = _mm_set1_ps(m.a), vb = _mm_set1_ps(m.b), vtx = _mm_set1_ps(m.tx);
+			__m128 vc = _mm_set1_ps(m.c), vd = _mm_set1_ps(m.d), vty = _mm_set1_ps(m.ty);
+			for(; i + 4 <= n; i += 4) {
+				__m128 px = _mm_loadu_ps(xs + i);
+				__m128 py = _mm_loadu_ps(ys + i);
+				__m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va, px), _mm_mul_ps(vb, py)), vtx);
+				__m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vc, px), _mm_mul_ps(vd, py)), vty);
+				_mm_storeu_si128((__m128i*)(ox + i), _mm_cvtps_epi32(tx));
+				_mm_storeu_si128((__m128i*)(oy + i), _mm_cvtps_epi32(ty));
+			}
+		#elif defined(MPWS_NEON)
+			float32x4_t vtx = vdupq_n_f32(m.tx), vty = vdupq_n_f32(m.ty);
+			for(; i + 4 <= n; i += 4) {
+				float32x4_t px = vld1q_f32(xs + i);
+				float32x4_t py = vld1q_f32(ys + i);
+				vst1q_s32(ox + i, vcvtnq_s32_f32(vmlaq_n_f32(vmlaq_n_f32(vtx, px, m.a), py, m.b)));
+				vst1q_s32(oy + i, vcvtnq_s32_f32(vmlaq_n_f32(vmlaq_n_f32(vty, px, m.c), py, m.d)));
+			}
+		#endif
+			for(; i < n; i++) {
+				f32 px = xs[i], py = ys[i];
+				ox[i] = (i32)lrintf(m.a*px + m.b*py + m.tx);
+				oy[i] = (i32)lrintf(m.c*px + m.d*py + m.ty);
+			}
+		}
+		
+		Bounds2D bounds() const {
+			Bounds2D b = {0, 0, 0, 0};
+			i32 n = size();
+			if(n == 0) return b;
+			b.minX = b.maxX = x[0];
+			b.minY = b.maxY = y[0];
+			i32 i = 0;
+		#if defined(MPWS_SSE2)
+			if(n >= 4) {
+				__m128 mnx = _mm_loadu_ps(x.data()), mxx = mnx;
+				__m128 mny = _mm_loadu_ps(y.data()), mxy = mny;
+				for(i = 4; i + 4 <= n; i += 4) {
+					__m128 px = _mm_loadu_ps(x.data() + i);
+					__m128 py = _mm_loadu_ps(y.data() + i);
+					mnx = _mm_min_ps(mnx, px); mxx = _mm_max_ps(mxx, px);
+					mny = _mm_min_ps(mny, py); mxy = _mm_max_ps(mxy, py);
+				}
+				f32 lanes[4][4];
+				_mm_storeu_ps(lanes[0], mnx); _mm_storeu_ps(lanes[1], mny);
+				_mm_storeu_ps(lanes[2], mxx); _mm_storeu_ps(lanes[3], mxy);
+				for(i32 l = 0; l < 4; l++) {
+					b.minX = std::min(b.minX, lanes[0][l]); b.minY = std::min(b.minY, lanes[1][l]);
+					b.maxX = std::max(b.maxX, lanes[2][l]); b.maxY = std::max(b.maxY, lanes[3][l]);
+				}
+			}
+		#elif defined(MPWS_NEON)
+			if(n >= 4) {
+				float32x4_t mnx = vld1q_f32(x.data()), mxx = mnx;
+				float32x4_t mny = vld1q_f32(y.data()), mxy = mny;
+				for(i = 4; i + 4 <= n; i += 4) {
+					float32x4_t px = vld1q_f32(x.data() + i);
+					float32x4_t py = vld1q_f32(y.data() + i);
+					mnx = vminq_f32(mnx, px); mxx = vmaxq_f32(mxx, px);
+					mny = vminq_f32(mny, py); mxy = vmaxq_f32(mxy, py);
+				}
+				b.minX = vminvq_f32(mnx); b.minY = vminvq_f32(mny);
+				b.maxX = vmaxvq_f32(mxx); b.maxY = vmaxvq_f32(mxy);
+			}
+		#endif
+			for(; i < n; i++) {
+				b.minX = std::min(b.minX, x[i]); b.minY = std::min(b.minY, y[i]);
+				b.maxX = std::max(b.maxX, x[i]); b.maxY = std::max(b.maxY, y[i]);
+			}
+			return b;
+		}
+	}; typedef struct FlointBuffer2D FlointBuffer2D;
+	
+	// lookup tables for blending text in linear light, toLinear maps an 8-bit channel
+	// to 12-bit linear light and fromLinear maps it back
+	typedef struct {
+		u16 toLinear[256];
+		u8 fromLinear[4096];
+	} text_gamma;
+	
+	inline void build_text_gamma(text_gamma* g, f32 gamma) {
+		for(i32 i = 0; i < 256; i++) g->toLinear[i] = (u16)lrintf(powf(i / 255.0f, gamma) * 4095.0f);
+		for(i32 i = 0; i < 4096; i++) g->fromLinear[i] = (u8)lrintf(powf(i / 4095.0f, 1.0f / gamma) * 255.0f);
+	}
+	
+	// blends c over a row of bgrx pixels by an 8-bit coverage each: d*(256-a) + c*a >> 8 with
+	// a = cov + cov/128 so 255 coverage writes c exactly. the padding byte is left alone
+	inline void blend_coverage_row(u8* dst, const u8* cov, i32 n, Color c) {
+		i32 x = 0;
+	#if defined(MPWS_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i color = _mm_setr_epi16(c.b, c.g, c.r, 0, c.b, c.g, c.r, 0);
+		const __m128i noPad = _mm_set1_epi32(0x00FFFFFF);
+		const __m128i full = _mm_set1_epi16(256);
+		for(; x + 4 <= n; x += 4) {
+			i32 packed;
+			memcpy(&packed, cov + x, 4);
+			if(packed == 0) continue;
+			
+			// spread every coverage over the 3 color bytes of its pixel
+			__m128i a = _mm_cvtsi32_si128(packed);
+			a = _mm_unpacklo_epi8(a, a);
+			a = _mm_and_si128(_mm_unpacklo_epi16(a, a), noPad);
+			__m128i aLo = _mm_unpacklo_epi8(a, zero);
+			__m128i aHi = _mm_unpackhi_epi8(a, zero);
+			aLo = _mm_add_epi16(aLo, _mm_srli_epi16(aLo, 7));
+			aHi = _mm_add_epi16(aHi, _mm_srli_epi16(aHi, 7));
+			
+			__m128i d = _mm_loadu_si128((const __m128i*)(dst + x*4));
+			__m128i dLo = _mm_unpacklo_epi8(d, zero);
+			__m128i dHi = _mm_unpackhi_epi8(d, zero);
+			dLo = _mm_add_epi16(_mm_mullo_epi16(dLo, _mm_sub_epi16(full, aLo)), _mm_mullo_epi16(color, aLo));
+			dHi = _mm_add_epi16(_mm_mullo_epi16(dHi, _mm_sub_epi16(full, aHi)), _mm_mullo_epi16(color, aHi));
+			d = _mm_packus_epi16(_mm_srli_epi16(dLo, 8), _mm_srli_epi16(dHi, 8));
+			_mm_storeu_si128((__m128i*)(dst + x*4), d);
+		}
+	#elif defined(MPWS_NEON)
+		const uint16x8_t cb = vdupq_n_u16(c.b), cg = vdupq_n_u16(c.g), cr = vdupq_n_u16(c.r);
+		for(; x + 8 <= n; x += 8) {
+			uint8x8_t a8 = vld1_u8(cov + x);
+			if(vget_lane_u64(vreinterpret_u64_u8(a8), 0) == 0) continue;
+			uint16x8_t a = vaddw_u8(vmovl_u8(a8), vshr_n_u8(a8, 7));
+			uint16x8_t inv = vsubq_u16(vdupq_n_u16(256), a);
+			
+			uint8x8x4_t d = vld4_u8(dst + x*4);
+			d.val[0] = vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d.val[0]), inv), cb, a), 8);
+			d.val[1] = vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d.val[1]), inv), cg, a), 8);
+			d.val[2] = vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d.val[2]), inv), cr, a), 8);
+			vst4_u8(dst + x*4, d);
+		}
+	#endif
+		for(; x < n; x++) {
+			u32 a = cov[x];
+			if(a == 0) continue;
+			a += a >> 7;
+			u8* p = dst + x*4;
+			p[0] = (u8)((p[0] * (256 - a) + c.b * a) >> 8);
+			p[1] = (u8)((p[1] * (256 - a) + c.g * a) >> 8);
+			p[2] = (u8)((p[2] * (256 - a) + c.r * a) >> 8);
+		}
+	}
+	
+	// same blend with one coverage per color byte, cov holds r g b triplets
+	inline void blend_coverage_row_lcd(u8* dst, const u8* cov, i32 n, Color c) {
+		i32 x = 0;
+	#if defined(MPWS_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i color = _mm_setr_epi16(c.b, c.g, c.r, 0, c.b, c.g, c.r, 0);
+		const __m128i full = _mm_set1_epi16(256);
+		const __m128i lane0 = _mm_setr_epi32(0x00FFFFFF, 0, 0, 0), lane1 = _mm_setr_epi32(0, 0x00FFFFFF, 0, 0);
+		const __m128i lane2 = _mm_setr_epi32(0, 0, 0x00FFFFFF, 0), lane3 = _mm_setr_epi32(0, 0, 0, 0x00FFFFFF);
+		const __m128i low = _mm_set1_epi32(0xFF), mid = _mm_set1_epi32(0xFF00);
+		for(; x + 4 <= n; x += 4) {
+			// the 12 coverage bytes of 4 pixels
+			i32 tail;
+			memcpy(&tail, cov + x*3 + 8, 4);
+			__m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(cov + x*3)), _mm_cvtsi32_si128(tail));
+			if(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) == 0xFFFF) continue;
+			
+			// every triplet into its own pixel, then r g b turned around to match b g r x
+			__m128i a = _mm_or_si128(_mm_or_si128(_mm_and_si128(v, lane0), _mm_and_si128(_mm_slli_si128(v, 1), lane1)),
+									 _mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 2), lane2), _mm_and_si128(_mm_slli_si128(v, 3), lane3)));
+			a = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(a, low), 16), _mm_and_si128(a, mid)),
+							 _mm_and_si128(_mm_srli_epi32(a, 16), low));
+			__m128i aLo = _mm_unpacklo_epi8(a, zero);
+			__m128i aHi = _mm_unpackhi_epi8(a, zero);
+			aLo = _mm_add_epi16(aLo, _mm_srli_epi16(aLo, 7));
+			aHi = _mm_add_epi16(aHi, _mm_srli_epi16(aHi, 7));
+			
+			__m128i d = _mm_loadu_si128((const __m128i*)(dst + x*4));
+			__m128i dLo = _mm_unpacklo_epi8(d, zero);
+			__m128i dHi = _mm_unpackhi_epi8(d, zero);
+			dLo = _mm_add_epi16(_mm_mullo_epi16(dLo, _mm_sub_epi16(full, aLo)), _mm_mullo_epi16(color, aLo));
+			dHi = _mm_add_epi16(_mm_mullo_epi16(dHi, _mm_sub_epi16(full, aHi)), _mm_mullo_epi16(color, aHi));
+			d = _mm_packus_epi16(_mm_srli_epi16(dLo, 8), _mm_srli_epi16(dHi, 8));
+			_mm_storeu_si128((__m128i*)(dst + x*4), d);
+		}
+	#elif defined(MPWS_NEON)
+		const uint16x8_t cb = vdupq_n_u16(c.b), cg = vdupq_n_u16(c.g), cr = vdupq_n_u16(c.r);
+		const uint16x8_t full = vdupq_n_u16(256);
+		for(; x + 8 <= n; x += 8) {
+			uint8x8x3_t a8 = vld3_u8(cov + x*3);
+			uint16x8_t ar = vaddw_u8(vmovl_u8(a8.val[0]), vshr_n_u8(a8.val[0], 7));
+			uint16x8_t ag = vaddw_u8(vmovl_u8(a8.val[1]), vshr_n_u8(a8.val[1], 7));
+			uint16x8_t ab = vaddw_u8(vmovl_u8(a8.val[2]), vshr_n_u8(a8.val[2], 7));
+			
+			uint8x8x4_t d = vld4_u8(dst + x*4);
+			d.val[0] = vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d.val[0]), vsubq_u16(full, ab)), cb, ab), 8);
+			d.val[1] = vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d.val[1]), vsubq_u16(full, ag)), cg, ag), 8);
+			d.val[2] = vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d.val[2]), vsubq_u16(full, ar)), cr, ar), 8);
+			vst4_u8(dst + x*4, d);
+		}
+	#endif
+		for(; x < n; x++) {
+			const u8* a3 = cov + x*3;
+			if((a3[0] | a3[1] | a3[2]) == 0) continue;
+			u32 ar = a3[0] + (a3[0] >> 7), ag = a3[1] + (a3[1] >> 7), ab = a3[2] + (a3[2] >> 7);
+			u8* p = dst + x*4;
+			p[0] = (u8)((p[0] * (256 - ab) + c.b * ab) >> 8);
+			p[1] = (u8)((p[1] * (256 - ag) + c.g * ag) >> 8);
+			p[2] = (u8)((p[2] * (256 - ar) + c.r * ar) >> 8);
+		}
+	}
+	
+	// linear light version of both blends, every channel goes through the lookup tables
+	// so it stays scalar but skips empty pixels and writes fully covered ones directly
+	inline void blend_coverage_row_gamma(u8* dst, const u8* cov, i32 n, i32 channels, Color c, const text_gamma* g) {
+		const u32 lb = g->toLinear[c.b], lg = g->toLinear[c.g], lr = g->toLinear[c.r];
+		const i32 gi = channels > 1 ? 1 : 0, bi = channels > 1 ? 2 : 0;
+		for(i32 x = 0; x < n; x++, dst += 4, cov += channels) {
+			u32 ar = cov[0], ag = cov[gi], ab = cov[bi];
+			if((ar | ag | ab) == 0) continue;
+			if((ar & ag & ab) == 255) {
+				dst[0] = c.b;
+				dst[1] = c.g;
+				dst[2] = c.r;
+				continue;
+			}
+			ar += ar >> 7;
+			ag += ag >> 7;
+			ab += ab >> 7;
+			dst[0] = g->fromLinear[(g->toLinear[dst[0]] * (256 - ab) + lb * ab) >> 8];
+			dst[1] = g->fromLinear[(g->toLinear[dst[1]] * (256 - ag) + lg * ag) >> 8];
+			dst[2] = g->fromLinear[(g->toLinear[dst[2]] * (256 - ar) + lr * ar) >> 8];
+		}
+	}
+
 //classes
 
 	class Raster {
@@ -356,6 +858,111 @@
 		u8* raster;
 		i32 width, height;
 		i32 valPerPix = 4;
+		
+		// vertices further than this away from the raster get clipped geometrically,
+		// keeps (x2 - x1) * (y - y1) of the span interpolation inside of i32
+		static const i32 guardBand = 4096;
+		
+		void fillSpan(i32 y, i32 xStart, i32 xEnd, u8 r, u8 g, u8 b) {
+			if(xStart < 0) xStart = 0;
+			if(xEnd >= width) xEnd = width - 1;
+			u8* px = raster + (y * width + xStart) * valPerPix;
+			for(i32 x = xStart; x <= xEnd; x++, px += valPerPix) {
+				px[0] = b;
+				px[1] = g;
+				px[2] = r;
+			}
+		}
+		
+		void fillTriangleSpans(i32 x0, i32 y0, i32 x1, i32 y1, i32 x2, i32 y2, u8 r,u8 g, u8 b) {
+			//sort the vertices by y-coordinates
+			auto sortVerticesByY = [](i32& x1, i32& y1, i32& x2, i32& y2, i32& x3, i32& y3) {
+				if(y1 > y2) { std::swap(x1, x2); std::swap(y1,y2); }
+				if(y1 > y3) { std::swap(x1, x3); std::swap(y1,y3); }
+				if(y2 > y3) { std::swap(x2, x3); std::swap(y2,y3); }
+			};
+
+			sortVerticesByY(x0,y0,x1,y1,x2,y2);
+
+			i32 xTop = x0, yTop = y0;
+			i32 xMid = x1, yMid = y1;
+			i32 xBottom = x2, yBottom = y2;
+
+			//Function to interpolate x-coordinates on a scanline
+			auto interpolateX = [](i32 x1, i32 y1, i32 x2, i32 y2, i32 y) -> i32 {
+				if(y1 == y2) return x1;
+				return x1 + (x2 - x1) * (y - y1) / (y2 - y1);
+			};
+
+			//only walk the scanlines that are on the raster
+			i32 yStart = yTop < 0 ? 0 : yTop;
+			i32 yEnd = yBottom >= height ? height - 1 : yBottom;
+
+			//Draw the filled triangle
+			for(i32 y = yStart; y <= yEnd; y++) {
+				i32 x1,x2;
+
+				//Determmine x-coordinates of the intersection points
+				if(y < yMid) {
+					x1 = interpolateX(xTop, yTop, xBottom, yBottom, y);
+					x2 = interpolateX(xTop, yTop, xMid, yMid, y);
+				} else {
+					x1 = interpolateX(xMid, yMid, xBottom, yBottom, y);
+					x2 = interpolateX(xTop, yTop, xBottom, yBottom, y);
+				}
+
+				//Ensure x1 is always the leftmost x-coordinate
+				if(x1 > x2) std::swap(x1,x2);
+				if(x2 < 0 || x1 >= width) continue;
+
+				fillSpan(y, x1, x2, r, g, b);
+			}
+		}
+		
+		// Sutherland–Hodgman against the 4 raster edges, a triangle can gain
+		// at most one vertex per edge so out needs room for 7 points (9 for safety)
+		i32 clipTriangle(Floint2D p0, Floint2D p1, Floint2D p2, Floint2D* out) {
+			Floint2D buffer[9];
+			Floint2D* src = buffer;
+			Floint2D* dst = out;
+			i32 count = 3;
+			src[0] = p0; src[1] = p1; src[2] = p2;
+			
+			const f32 maxX = (f32)(width - 1);
+			const f32 maxY = (f32)(height - 1);
+			
+			for(i32 edge = 0; edge < 4 && count > 0; edge++) {
+				// signed distance to the clip edge, positive means inside
+				auto distance = [&](const Floint2D& p) -> f32 {
+					switch(edge) {
+						case 0: return p.x;
+						case 1: return maxX - p.x;
+						case 2: return p.y;
+						default: return maxY - p.y;
+					}
+				};
+				
+				i32 outCount = 0;
+				for(i32 i = 0; i < count; i++) {
+					const Floint2D& a = src[i];
+					const Floint2D& b = src[(i + 1) % count];
+					f32 da = distance(a);
+					f32 db = distance(b);
+					
+					if(da >= 0) dst[outCount++] = a;
+					if((da >= 0) != (db >= 0)) {
+						f32 t = da / (da - db);
+						dst[outCount++] = Floint2D(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+					}
+				}
+				count = outCount;
+				std::swap(src, dst);
+			}
+			
+			//after an even number of passes the result lives in the local buffer
+			if(src != out) memcpy(out, src, sizeof(Floint2D) * count);
+			return count;
+		}
 	public:
 		
 		Raster(i32 width, i32 height): width(width), height(height) {
@@ -385,15 +992,42 @@
 			}
 		}void setColor(i32 x, i32 y, Color c) {setColor(x, y, c.r, c.g, c.b);}
 		
+		// mixes c over the pixel by an 8-bit coverage, 255 replaces it
+		void blendPixel(i32 x, i32 y, Color c, u8 coverage) {
+			if (x < 0 || x >= width || y < 0 || y >= height) return;
+			blend_coverage_row(raster + (y * width + x) * valPerPix, &coverage, 1, c);
+		}
+		
+		// blends c over the pixels under a w x h coverage mask with channels bytes per pixel
+		// (1, or 3 for lcd masks). mask rows are stride bytes apart and go up from (x, y) when
+		// bottomUp is set like glyph bitmaps do, down otherwise. the mask gets clipped once and
+		// then blended a row at a time, in linear light when gamma tables are given
+		void blendMask(i32 x, i32 y, const u8* mask, i32 stride, i32 w, i32 h, i32 channels,
+					   bool bottomUp, Color c, const text_gamma* gamma = nullptr) {
+			i32 i0 = std::max(0, -x);
+			i32 i1 = std::min(w, width - x);
+			i32 j0 = bottomUp ? std::max(0, y - height + 1) : std::max(0, -y);
+			i32 j1 = bottomUp ? std::min(h, y + 1) : std::min(h, height - y);
+			if(i0 >= i1 || j0 >= j1) return;
+			
+			for(i32 j = j0; j < j1; j++) {
+				const u8* cov = mask + (size_t)j * stride + (size_t)i0 * channels;
+				u8* dst = raster + ((size_t)(bottomUp ? y - j : y + j) * width + x + i0) * valPerPix;
+				if(gamma) blend_coverage_row_gamma(dst, cov, i1 - i0, channels, c, gamma);
+				else if(channels == 3) blend_coverage_row_lcd(dst, cov, i1 - i0, c);
+				else blend_coverage_row(dst, cov, i1 - i0, c);
+			}
+		}
+		
 		void clearChunk(i32 yStart, i32 yEnd, Color c) {
 			const i32 rowSize = width * valPerPix;
 			for (i32 y = yStart; y < yEnd; ++y) {
 				i32 rowStart = y * rowSize;
 				for (i32 x = 0; x < width; ++x) {
 					i32 index = rowStart + x * valPerPix;
-					raster[index + 0] = c.r;
+					raster[index + 0] = c.b;
 					raster[index + 1] = c.g;
-					raster[index + 2] = c.b;
+					raster[index + 2] = c.r;
 				}
 			}
 		}
@@ -432,47 +1066,57 @@
 
 
 		void fillTriangle(i32 x0, i32 y0, i32 x1, i32 y1, i32 x2, i32 y2, u8 r,u8 g, u8 b) {
-			//sort the vertices by y-coordinates
-			auto sortVerticesByY = [](i32& x1, i32& y1, i32& x2, i32& y2, i32& x3, i32& y3) {
-				if(y1 > y2) { std::swap(x1, x2); std::swap(y1,y2); }
-				if(y1 > y3) { std::swap(x1, x3); std::swap(y1,y1); }
-				if(y2 > y3) { std::swap(x2, x3); std::swap(y2,y3); }
-			};
-
-			sortVerticesByY(x0,y0,x1,y1,x2,y2);
-
-			i32 xTop = x0, yTop = y0;
-			i32 xMid = x1, yMid = y1;
-			i32 xBottom = x2, yBottom = y2;
-
-			//Function to interpolate x-coordinates on a scanline
-			auto interpolateX = [](i32 x1, i32 y1, i32 x2, i32 y2, i32 y) -> i32 {
-				if(y1 == y2) return x1;
-				return x1 + (x2 - x1) * (y - y1) / (y2 - y1);
+			//trivially reject triangles that are completely outside of the raster
+			if(x0 < 0 && x1 < 0 && x2 < 0) return;
+			if(y0 < 0 && y1 < 0 && y2 < 0) return;
+			if(x0 >= width && x1 >= width && x2 >= width) return;
+			if(y0 >= height && y1 >= height && y2 >= height) return;
+
+			//inside the guard band the spans can be clamped directly without overflowing the interpolation
+			auto inGuardBand = [this](i32 x, i32 y) -> bool {
+				return x >= -guardBand && x < width + guardBand && y >= -guardBand && y < height + guardBand;
 			};
+			if(inGuardBand(x0, y0) && inGuardBand(x1, y1) && inGuardBand(x2, y2)) {
+				fillTriangleSpans(x0, y0, x1, y1, x2, y2, r, g, b);
+				return;
+			}
 
-			//Draw the filled triangle
-			for(i32 y = yTop; y <= yBottom; y++) {
-				i32 x1,x2;
-
-				//Determmine x-coordinates of the intersection points
-				if(y < yMid) {
-					x1 = interpolateX(xTop, yTop, xBottom, yBottom, y);
-					x2 = interpolateX(xTop, yTop, xMid, yMid, y);
-				} else {
-					x1 = interpolateX(xMid, yMid, xBottom, yBottom, y);
-					x2 = interpolateX(xTop, yTop, xBottom, yBottom, y);
-				}
-
-				//Ensure x1 is always the leftmost x-coordinate
-				if(x1 > x2) std::swap(x1,x2);
-
-				//Draw horizontal line between x1 and x2
-				for(i32 x = x1; x <= x2; ++x) {
-					setColor(x, y, r, g, b);
-				}
+			//otherwise clip the triangle against the raster and fan out the resulting polygon
+			Floint2D poly[9];
+			i32 count = clipTriangle(Floint2D(x0, y0), Floint2D(x1, y1), Floint2D(x2, y2), poly);
+			for(i32 i = 1; i + 1 < count; i++) {
+				fillTriangleSpans(lroundf(poly[0].x), lroundf(poly[0].y),
+								  lroundf(poly[i].x), lroundf(poly[i].y),
+								  lroundf(poly[i+1].x), lroundf(poly[i+1].y), r, g, b);
 			}
 		}void fillTriangle(i32 x0, i32 y0, i32 x1, i32 y1, i32 x2, i32 y2, Color c) {fillTriangle(x0,y0,x1,y1,x2,y2,c.r,c.g,c.b);}
+		
+		// batched draw calls taking structure of arrays buffers
+		void drawPoints(const PointBuffer2D& pts, u8 r, u8 g, u8 b) {
+			const i32* xs = pts.x.data();
+			const i32* ys = pts.y.data();
+			for(i32 i = 0; i < pts.size(); i++) {
+				// one unsigned compare per axis covers both < 0 and >= size
+				if((u32)xs[i] >= (u32)width || (u32)ys[i] >= (u32)height) continue;
+				u8* px = raster + (ys[i] * width + xs[i]) * valPerPix;
+				px[0] = b;
+				px[1] = g;
+				px[2] = r;
+			}
+		}void drawPoints(const PointBuffer2D& pts, Color c) {drawPoints(pts, c.r, c.g, c.b);}
+		
+		void drawLineStrip(const PointBuffer2D& pts, u8 r, u8 g, u8 b) {
+			for(i32 i = 0; i + 1 < pts.size(); i++) {
+				drawLine(pts.x[i], pts.y[i], pts.x[i+1], pts.y[i+1], r, g, b);
+			}
+		}void drawLineStrip(const PointBuffer2D& pts, Color c) {drawLineStrip(pts, c.r, c.g, c.b);}
+		
+		// every 3 consecutive points form one triangle
+		void fillTriangles(const PointBuffer2D& pts, u8 r, u8 g, u8 b) {
+			for(i32 i = 0; i + 2 < pts.size(); i += 3) {
+				fillTriangle(pts.x[i], pts.y[i], pts.x[i+1], pts.y[i+1], pts.x[i+2], pts.y[i+2], r, g, b);
+			}
+		}void fillTriangles(const PointBuffer2D& pts, Color c) {fillTriangles(pts, c.r, c.g, c.b);}
 
 		
 		i32 size() {return width * height * valPerPix;}
@@ -481,384 +1125,1379 @@
 
 
 
-	class Window_common {
-	public:
+	// rasterized glyph coverage, rows are stored bottom up like rasterize_glyph produces them
+	// and are stride bytes apart because the coverage lives inside of the glyph atlas
+	typedef struct {
 		i32 width;
 		i32 height;
-		i32 posX = 0;
-		i32 posY = 0;
-		const i8* name;
-		Raster r = Raster(0,0);
+		i32 stride;
+		i32 left;   // pixels from the pen position to the first column
+		i32 bottom; // pixels from the baseline to the first (lowest) row, negative for descenders
+		i32 channels; // 1 for plain coverage, 3 for lcd subpixel coverage in r g b order
+		u8* coverage;
+	} glyph_bitmap;
+	
+	// one 8-bit coverage surface all cached glyphs get packed into with a skyline allocator
+	class GlyphAtlas {
+	private:
+		typedef struct {
+			i32 x, y, width;
+		} SkylineNode;
 		
-		i32 getWidht() {return width;}
-		i32 getHeight() {return height;}
-		i32 getPosX() {return posX;}
-		i32 getPosY() {return posY;}
+		std::vector<SkylineNode> skyline_;
+		u8* pixels_ = nullptr;
+		i32 width_ = 0;
+		i32 height_ = 0;
 		
-	//font logic
-		// Parsed TrueType tables
-		font_directory  fontDir_;
-		head_table *head_ = nullptr;
-		os2_table *os2_ = nullptr;
-		i8* loca_ = nullptr;
+		// lowest y a rect of the given width can sit at when starting at node i, -1 if it does not fit
+		i32 fitAt(size_t i, i32 w, i32 h) const {
+			i32 x = skyline_[i].x;
+			if(x + w > width_) return -1;
+			i32 y = 0;
+			i32 remaining = w;
+			for(; remaining > 0; i++) {
+				y = std::max(y, skyline_[i].y);
+				if(y + h > height_) return -1;
+				remaining -= skyline_[i].width;
+			}
+			return y;
+		}
 		
-		u16 cmapSegCount_ = 0;
-		const u16 *cmapEndCode_ = nullptr;
-		const u16 *cmapStartCode_ = nullptr;
-
-		// Scaling
-		f32 scale_ = 1.0f;
-		f32 baselinePx_ = 0.0f;
-		u16 unitsPerEm_ = 0;
+	public:
+		GlyphAtlas() {}
+		~GlyphAtlas() {free(pixels_);}
 		
-		// Cached glyph outlines
-		std::unordered_map<u8, glyph_outline> glyphMap_;
+		GlyphAtlas(const GlyphAtlas&) = delete;
+		GlyphAtlas& operator=(const GlyphAtlas&) = delete;
 		
-		// Cached letter bitmaps based of font size and character index
-		std::unordered_map<int, std::unordered_map<i32, u8*>> letterBitmaps;
-		
-		
-		i8* read_file(const i8 *file_name, i32* file_size) { 
-			if(strlen(file_name) > 0) {
-				FILE* file = fopen(file_name, "rb");
-				if(file) {
-					fseek(file, 0, SEEK_END);
-					i32 size = ftell(file);
-					fseek(file, 0, SEEK_SET);
-
-					if(file_size) { *file_size = size; }
-					i8 *file_content = (i8*)malloc(size+1);
-					i32 read_amount = fread(file_content, size, 1, file);
-					file_content[size] = '\0';
-					if(read_amount) {
-						fclose(file);
-						return file_content;
-					}
-					free(file_content);
-					fclose(file);
-					return NULL;
-				}
-			}
-			return NULL;
+		// drops all rects and gives the atlas a fresh zeroed surface
+		void reset(i32 w, i32 h) {
+			free(pixels_);
+			width_ = w;
+			height_ = h;
+			pixels_ = (u8*) calloc((size_t)w * h, sizeof(u8));
+			skyline_.clear();
+			skyline_.push_back({0, 0, w});
 		}
 		
-		void read_cmap(i8* mem, cmap* c) {
-			i8 *m = mem;
-			c->version = READ_BE16_MOVE(m);
-			c->numberSubtables = READ_BE16_MOVE(m);
-
-			c->subtables = (cmap_encoding_subtable*) calloc(1, sizeof(cmap_encoding_subtable)*c->numberSubtables);
-			for(i32 i = 0; i < c->numberSubtables; ++i) {
-				cmap_encoding_subtable* est = c->subtables + i;
-				est->platformID = READ_BE16_MOVE(m);
-				est->platformSpecificID = READ_BE16_MOVE(m);
-				est->offset = READ_BE32_MOVE(m);
-			}
+		// hands the surface over to the caller so glyphs can be copied out during a repack
+		u8* release() {
+			u8* p = pixels_;
+			pixels_ = nullptr;
+			return p;
 		}
 		
-		void read_format4(i8* mem, format4** format) {
-			i8* m = mem;
-
-			u16 length = READ_BE16(m + 2);
-
-			format4* f = NULL;
-
-			f = (format4*) calloc(1, length + sizeof(u16*)*5);
-			f->format = READ_BE16_MOVE(m);
-			f->length = READ_BE16_MOVE(m);
-			f->language = READ_BE16_MOVE(m);
-			f->segCountX2 = READ_BE16_MOVE(m);
-			f->searchRange = READ_BE16_MOVE(m);
-			f->entrySelector = READ_BE16_MOVE(m);
-			f->rangeShift = READ_BE16_MOVE(m);
-
-			f->endCode = (u16*) ((u8*)f  + sizeof(format4));
-			f->startCode = f->endCode + f->segCountX2/2;
-			f->idDelta = f->startCode + f->segCountX2/2;
-			f->idRangeOffset = f->idDelta + f->segCountX2/2;
-			f->glyphIdArray = f->idRangeOffset + f->segCountX2/2;
-
-			i8* start_code_start = m + f->segCountX2 + 2;
-			i8* id_delta_start = m + f->segCountX2*2 + 2;
-			i8* id_range_start = m + f->segCountX2*3 + 2;
-
-			for(i32 i = 0; i < f->segCountX2/2; ++i) {
-				f->endCode[i] = READ_BE16(m + i*2);
-				f->startCode[i] = READ_BE16(start_code_start + i*2);
-				f->idDelta[i] = READ_BE16(id_delta_start + i*2);
-				f->idRangeOffset[i] = READ_BE16(id_range_start + i*2);
+		bool allocate(i32 w, i32 h, i32* outX, i32* outY) {
+			i32 bestIndex = -1, bestY = height_, bestWidth = width_ + 1;
+			for(size_t i = 0; i < skyline_.size(); i++) {
+				i32 y = fitAt(i, w, h);
+				if(y < 0) continue;
+				// bottom-left: lowest top edge wins, narrower nodes break ties
+				if(y + h < bestY || (y + h == bestY && skyline_[i].width < bestWidth)) {
+					bestIndex = (i32)i;
+					bestY = y + h;
+					bestWidth = skyline_[i].width;
+				}
 			}
-
-			P_MOVE(m, f->segCountX2*4 + 2);	
-
-			i32 remaining_bytes = f->length - (m - mem);
-			for(i32 i = 0; i < remaining_bytes/2; ++i) {
-				f->glyphIdArray[i] = READ_BE16_MOVE(m);
+			if(bestIndex < 0) return false;
+			
+			SkylineNode node = {skyline_[bestIndex].x, bestY, w};
+			skyline_.insert(skyline_.begin() + bestIndex, node);
+			
+			// shrink or drop the nodes now covered by the new one
+			for(size_t i = bestIndex + 1; i < skyline_.size(); ) {
+				SkylineNode& prev = skyline_[i-1];
+				SkylineNode& cur = skyline_[i];
+				i32 overlap = prev.x + prev.width - cur.x;
+				if(overlap <= 0) break;
+				cur.x += overlap;
+				cur.width -= overlap;
+				if(cur.width > 0) break;
+				skyline_.erase(skyline_.begin() + i);
 			}
-
-			*format = f;
+			
+			// merge neighbours at the same height
+			for(size_t i = 0; i + 1 < skyline_.size(); ) {
+				if(skyline_[i].y == skyline_[i+1].y) {
+					skyline_[i].width += skyline_[i+1].width;
+					skyline_.erase(skyline_.begin() + i + 1);
+				} else {
+					i++;
+				}
+			}
+			
+			*outX = node.x;
+			*outY = bestY - h;
+			return true;
 		}
 		
-		void read_offset_subtable(i8** mem, offset_subtable* off_sub) {
-			i8* m = *mem;
-			off_sub->scaler_type = READ_BE32_MOVE(m);
-			off_sub->numTables = READ_BE16_MOVE(m);
-			off_sub->searchRange = READ_BE16_MOVE(m);
-			off_sub->entrySelector = READ_BE16_MOVE(m);
-			off_sub->rangeShift = READ_BE16_MOVE(m);
+		u8* at(i32 x, i32 y) {return pixels_ + (size_t)y * width_ + x;}
+		i32 width() const {return width_;}
+		i32 height() const {return height_;}
+		u8* pixels() {return pixels_;}
+	};
 
-			*mem = m;
-		}
+	// glyph coverage bitmaps keyed by (codepoint, pixel size) and packed into one atlas,
+	// once the atlas is full and has reached the memory budget the least recently drawn
+	// glyphs get evicted and the survivors are repacked
+	class GlyphCache {
+	private:
+		typedef struct {
+			uint64_t key;
+			i32 x, y;
+			i32 width, height; // width in bytes, pixels times channels
+			i32 left, bottom;
+			i32 channels;
+		} Entry;
 		
-		void read_table_directory(i8* file_start, i8** mem, font_directory* ft) {
-			i8* m = *mem;
-			ft->tbl_dir = (table_directory*)calloc(1, sizeof(table_directory)*ft->off_sub.numTables);
-
-			for(i32 i = 0; i < ft->off_sub.numTables; ++i) {
-				table_directory* t = ft->tbl_dir + i;
-				t->tag = READ_BE32_MOVE(m);
-				t->checkSum = READ_BE32_MOVE(m);
-				t->offset = READ_BE32_MOVE(m);
-				t->length = READ_BE32_MOVE(m);
-
-				switch(t->tag) {
-					case GLYF_TAG: ft->glyf = t->offset + file_start; break;
-					case LOCA_TAG: ft->loca = t->offset + file_start; break;
-					case HEAD_TAG: ft->head = t->offset + file_start; break;
-					case CMAP_TAG: {
-						ft->cmap = (cmap*) calloc(1, sizeof(cmap));
-						read_cmap(file_start + t->offset, ft->cmap);
-						read_format4(file_start + t->offset + ft->cmap->subtables[0].offset, &ft->f4);
-					} break;
-					case OS2_TAG:  ft->os2  = t->offset + file_start; break;
-				}
-			}
-
-			*mem = m;
-		}
+		std::list<Entry> lru_; // front is the most recently used
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+		GlyphAtlas atlas_;
+		glyph_bitmap view_;
+		size_t budget_;
+		size_t used_ = 0;
 		
-		void read_font_directory(i8* file_start, i8** mem, font_directory* ft) {
-			read_offset_subtable(mem, &ft->off_sub); 
-			read_table_directory(file_start, mem, ft);
+		static const i32 initialAtlasSize = 256;
+		
+		static uint64_t makeKey(u32 codepoint, i32 size) {return ((uint64_t)(u32)size << 32) | codepoint;}
+		
+		glyph_bitmap* view(const Entry& e) {
+			view_.width = e.width / e.channels;
+			view_.height = e.height;
+			view_.channels = e.channels;
+			view_.stride = atlas_.width();
+			view_.left = e.left;
+			view_.bottom = e.bottom;
+			view_.coverage = atlas_.at(e.x, e.y);
+			return &view_;
 		}
 		
-		i32 read_loca_type(font_directory* ft) {
-			return READ_BE16(ft->head + 50);
+		void erase(std::list<Entry>::iterator it) {
+			used_ -= (size_t)it->width * it->height;
+			index_.erase(it->key);
+			lru_.erase(it);
 		}
 		
-		void parseTables() {
-			// Head table must have been set by read_font_directory
-			if (!fontDir_.head)
-				throw std::runtime_error("No head table found");
-			head_ = reinterpret_cast<head_table*>(fontDir_.head);
-
-			// OS/2 table pointer
-			if (!fontDir_.os2)
-				throw std::runtime_error("No OS/2 table found");
-			os2_ = reinterpret_cast<os2_table*>(fontDir_.os2);
+		// moves every live glyph into a fresh surface of the given size, tallest first
+		// so the skyline stays flat, glyphs that no longer fit get dropped
+		void repack(i32 w, i32 h) {
+			i32 oldWidth = atlas_.width();
+			u8* old = atlas_.release();
+			atlas_.reset(w, h);
 			
-			// OS/2 table pointer
-			if (!fontDir_.loca)
-				throw std::runtime_error("No loca table found");
-			loca_ = reinterpret_cast<char*>(fontDir_.loca);
-
-			// cmap format4 data prepared in read_font_directory
-			if (!fontDir_.cmap || !fontDir_.f4) {
-				cmapSegCount_   = 0;
-				cmapEndCode_    = nullptr;
-				cmapStartCode_  = nullptr;
-				return;
+			std::vector<std::list<Entry>::iterator> order;
+			for(auto it = lru_.begin(); it != lru_.end(); ++it) order.push_back(it);
+			std::stable_sort(order.begin(), order.end(), [](std::list<Entry>::iterator a, std::list<Entry>::iterator b) {
+				return a->height > b->height;
+			});
+			
+			for(auto it : order) {
+				i32 nx, ny;
+				if(!atlas_.allocate(it->width, it->height, &nx, &ny)) {
+					erase(it);
+					continue;
+				}
+				for(i32 row = 0; row < it->height; row++) {
+					memcpy(atlas_.at(nx, ny + row), old + (size_t)(it->y + row) * oldWidth + it->x, it->width);
+				}
+				it->x = nx;
+				it->y = ny;
 			}
-
-			format4* f4 = fontDir_.f4;
-			cmapSegCount_   = f4->segCountX2 / 2;
-			cmapEndCode_    = f4->endCode;
-			cmapStartCode_  = f4->startCode;
+			free(old);
 		}
 		
-		i32 get_glyph_index(font_directory* ft, u16 code_point) {
-			format4 *f = ft->f4;
-			i32 index = -1;
-			u16 *ptr = NULL;
-			for(i32 i = 0; i < f->segCountX2/2; i++) {
-				if(f->endCode[i] > code_point) {index = i; break;};
+		// the surface growing ends up with under the budget, same steps as allocate
+		void maxAtlasSize(i32* w, i32* h) const {
+			*w = atlas_.width();
+			*h = atlas_.height();
+			while((size_t)*w * *h * 2 <= budget_) {
+				if(*h < *w) *h *= 2;
+				else *w *= 2;
 			}
+		}
+		
+		bool allocate(i32 w, i32 h, i32* x, i32* y) {
+			if(atlas_.pixels() == nullptr) atlas_.reset(initialAtlasSize, initialAtlasSize);
 			
-			if(index == -1) return 0;
-
-			if(f->startCode[index] < code_point) {
-				if(f->idRangeOffset[index] != 0) {
-					ptr = f->idRangeOffset + index + f->idRangeOffset[index]/2;
-					ptr += code_point - f->startCode[index];
-					if(*ptr == 0) return 0;
-					return (i16) (*ptr + f->idDelta[index]);
-				} else {
-					return (i16) (code_point + f->idDelta[index]);
-				}
+			// a glyph that would not even fit the biggest empty atlas must not flush the cache
+			i32 maxWidth, maxHeight;
+			maxAtlasSize(&maxWidth, &maxHeight);
+			if(w > maxWidth || h > maxHeight) return false;
+			
+			if(atlas_.allocate(w, h, x, y)) return true;
+			
+			// grow while the budget allows it, doubling the shorter side
+			while((size_t)atlas_.width() * atlas_.height() * 2 <= budget_) {
+				if(atlas_.height() < atlas_.width()) repack(atlas_.width(), atlas_.height() * 2);
+				else repack(atlas_.width() * 2, atlas_.height());
+				if(atlas_.allocate(w, h, x, y)) return true;
+			}
+			
+			// full, keep the most recent half and repack it. when the glyph still does not fit
+			// keep less, an empty atlas always has room for it
+			size_t keep = (size_t)atlas_.width() * atlas_.height() / 2;
+			for(;;) {
+				while(!lru_.empty() && used_ + (size_t)w * h > keep) erase(std::prev(lru_.end()));
+				repack(atlas_.width(), atlas_.height());
+				if(atlas_.allocate(w, h, x, y)) return true;
+				if(lru_.empty()) return false;
+				keep /= 2;
 			}
-
-			return 0;
 		}
 		
-		u32 get_glyph_offset(font_directory *ft, u32 glyph_index) {
-			u32 offset = 0;
-			if(read_loca_type(ft)) {
-				//32 bit
-				offset = READ_BE32((u32*)ft->loca + glyph_index);
-			} else {
-				offset =  READ_BE16((u16*)ft->loca + glyph_index)*2;
-			}
-			return offset;
+	public:
+		GlyphCache(size_t budgetBytes = 4 << 20): budget_(budgetBytes) {}
+		
+		GlyphCache(const GlyphCache&) = delete;
+		GlyphCache& operator=(const GlyphCache&) = delete;
+		
+		// unlike find this does not count as a use
+		bool contains(u32 codepoint, i32 size) const {return index_.count(makeKey(codepoint, size)) != 0;}
+		
+		// the returned view is valid until the next find or insert
+		glyph_bitmap* find(u32 codepoint, i32 size) {
+			auto it = index_.find(makeKey(codepoint, size));
+			if(it == index_.end()) return nullptr;
+			lru_.splice(lru_.begin(), lru_, it->second);
+			return view(*it->second);
 		}
 		
-		glyph_outline deep_copy_glyph_outline(const glyph_outline& src) {
-			glyph_outline dst = src;
-
-			i32 pointCount = src.endPtsOfContours[src.numberOfContours - 1] + 1;
-
-			dst.endPtsOfContours = (u16*)calloc(src.numberOfContours, sizeof(u16));
-			memcpy(dst.endPtsOfContours, src.endPtsOfContours, src.numberOfContours * sizeof(u16));
-
-			dst.instructions = (u8*)calloc(src.instructionLength, 1);
-			memcpy(dst.instructions, src.instructions, src.instructionLength);
-
-			dst.flags = (glyph_flag*)calloc(pointCount, sizeof(glyph_flag));
-			memcpy(dst.flags, src.flags, pointCount * sizeof(glyph_flag));
-
-			dst.xCoordinates = (i16*)calloc(pointCount, sizeof(i16));
-			memcpy(dst.xCoordinates, src.xCoordinates, pointCount * sizeof(i16));
-
-			dst.yCoordinates = (i16*)calloc(pointCount, sizeof(i16));
-			memcpy(dst.yCoordinates, src.yCoordinates, pointCount * sizeof(i16));
-
-			return dst;
+		// returns a zeroed bitmap that is already owned by the cache, nullptr without evicting
+		// anything when the glyph is bigger than the largest atlas the budget allows
+		glyph_bitmap* insert(u32 codepoint, i32 size, i32 width, i32 height, i32 left = 0, i32 bottom = 0, i32 channels = 1) {
+			uint64_t key = makeKey(codepoint, size);
+			width *= channels;
+			auto it = index_.find(key);
+			if(it != index_.end()) erase(it->second);
+			
+			i32 x, y;
+			if(!allocate(width, height, &x, &y)) return nullptr;
+			for(i32 row = 0; row < height; row++) memset(atlas_.at(x, y + row), 0, width);
+			
+			Entry e = {key, x, y, width, height, left, bottom, channels};
+			lru_.push_front(e);
+			index_[key] = lru_.begin();
+			used_ += (size_t)width * height;
+			return view(e);
 		}
-
 		
-		glyph_outline get_glyph_outline(font_directory* ft, u32 glyph_index) {
-			u32 offset = get_glyph_offset(ft, glyph_index);
-			unsigned char* glyph_start = (unsigned char*)(ft->glyf + offset);
-			glyph_outline outline = {0};
-			outline.numberOfContours = READ_BE16_MOVE(glyph_start);
-			outline.xMin = READ_BE16_MOVE(glyph_start);
-			outline.yMin = READ_BE16_MOVE(glyph_start);
-			outline.xMax = READ_BE16_MOVE(glyph_start);
-			outline.yMax = READ_BE16_MOVE(glyph_start);
-
-			outline.endPtsOfContours = (u16*) calloc(1, outline.numberOfContours*sizeof(u16));
-			for(i32 i = 0; i < outline.numberOfContours; ++i) {
-				outline.endPtsOfContours[i] = READ_BE16_MOVE(glyph_start);
+		void setBudget(size_t budgetBytes) {
+			budget_ = budgetBytes;
+			if(atlas_.pixels() == nullptr) return;
+			
+			i32 w = atlas_.width(), h = atlas_.height();
+			while((size_t)w * h > budget_ && w > initialAtlasSize / 4) {
+				if(w > h) w /= 2;
+				else h /= 2;
 			}
+			if(w != atlas_.width() || h != atlas_.height()) {
+				while(!lru_.empty() && used_ > (size_t)w * h / 2) erase(std::prev(lru_.end()));
+				repack(w, h);
+			}
+		}
+		
+		void clear() {
+			lru_.clear();
+			index_.clear();
+			used_ = 0;
+			if(atlas_.pixels()) atlas_.reset(atlas_.width(), atlas_.height());
+		}
+		
+		size_t budget() const {return budget_;}
+		size_t used() const {return used_;}
+		size_t count() const {return lru_.size();}
+		GlyphAtlas& atlas() {return atlas_;}
+	};
 
-			outline.instructionLength = READ_BE16_MOVE(glyph_start);
-			outline.instructions = (u8*)calloc(1, outline.instructionLength);
-			memcpy(outline.instructions, glyph_start, outline.instructionLength);
-			P_MOVE(glyph_start, outline.instructionLength);
-
-			i32 last_index = outline.endPtsOfContours[outline.numberOfContours-1];
-			outline.flags = (glyph_flag*) calloc(1, last_index + 1);
-
-			for(i32 i = 0; i < (last_index + 1); ++i) {
-				outline.flags[i].flag = *glyph_start;
-				glyph_start++;
-				if(outline.flags[i].repeat) {
-					u8 repeat_count = *glyph_start;
-					while(repeat_count-- > 0) {
-						i++;
-						outline.flags[i] = outline.flags[i-1];
+	// codepoint to glyph index, built once per font. The BMP goes through a two level page
+	// table (pages without any mapped codepoint share one zero page), the supplementary
+	// planes binary search the format 12 groups in place
+	class CmapLookup {
+	private:
+		u16* pages_[256];
+		u16 zeroPage_[256];
+		format12 f12_;
+		bool external_ = false; // pages belong to a font cache file
+		
+		void set(u32 codepoint, u16 glyph) {
+			u16*& page = pages_[codepoint >> 8];
+			if(page == zeroPage_) page = (u16*) calloc(256, sizeof(u16));
+			page[codepoint & 0xFF] = glyph;
+		}
+		
+		void addFormat4(const format4& f) {
+			const BEView& t = f.table;
+			for(u32 i = 0; i < f.segCountX2/2u; i++) {
+				u32 endCode = t.be16(f.endCode + i*2);
+				u32 startCode = t.be16(f.startCode + i*2);
+				u16 idDelta = t.be16(f.idDelta + i*2);
+				u16 idRangeOffset = t.be16(f.idRangeOffset + i*2);
+				
+				for(u32 c = startCode; c <= endCode; c++) {
+					u16 glyph;
+					if(idRangeOffset != 0) {
+						// the offset is relative to the idRangeOffset entry itself
+						glyph = t.be16(f.idRangeOffset + i*2 + idRangeOffset + (c - startCode)*2);
+						if(glyph != 0) glyph = (u16)(glyph + idDelta);
+					} else {
+						glyph = (u16)(c + idDelta);
 					}
-					glyph_start++;
+					if(glyph != 0) set(c, glyph);
 				}
 			}
-
-
-			outline.xCoordinates = (i16*) calloc(1, (last_index+1)*2);
-			i16 prev_coordinate = 0;
-			i16 current_coordinate = 0;
-			for(i32 i = 0; i < (last_index+1); ++i) {
-				i32 flag_combined = outline.flags[i].x_short << 1 | outline.flags[i].x_short_pos;
-				switch(flag_combined) {
-					case 0: {
-						current_coordinate = READ_BE16_MOVE(glyph_start);
-					} break;
-					case 1: { current_coordinate = 0; }break;
-					case 2: { current_coordinate = (*glyph_start++)*-1; }break;
-					case 3: { current_coordinate = (*glyph_start++); } break;
-				}
-
-				outline.xCoordinates[i] = current_coordinate + prev_coordinate;
-				prev_coordinate = outline.xCoordinates[i];
+		}
+		
+		void addFormat12Bmp(const format12& f) {
+			for(u32 i = 0; i < f.numGroups; i++) {
+				u32 at = f.groups + i*12;
+				u32 startCode = f.table.be32(at);
+				u32 endCode = std::min(f.table.be32(at + 4), 0xFFFFu);
+				u32 glyph = f.table.be32(at + 8);
+				for(u32 c = startCode; c <= endCode; c++) set(c, (u16)(glyph + c - startCode));
+			}
+		}
+		
+	public:
+		CmapLookup() {
+			memset(zeroPage_, 0, sizeof(zeroPage_));
+			for(i32 i = 0; i < 256; i++) pages_[i] = zeroPage_;
+			f12_ = format12();
+		}
+		~CmapLookup() {clear();}
+		
+		CmapLookup(const CmapLookup&) = delete;
+		CmapLookup& operator=(const CmapLookup&) = delete;
+		
+		void build(const format4& f4, const format12& f12) {
+			clear();
+			f12_ = f12;
+			if(f4.table.valid()) addFormat4(f4);
+			else if(f12.table.valid()) addFormat12Bmp(f12);
+		}
+		
+		// uses 256 entry pages that live somewhere else (a mapped font cache) instead of building
+		// them, index[i] is the page of codepoints i*256 to i*256+255 or 0xFFFF when all are 0
+		void attach(const u16* index, const u16* pages, const format12& f12) {
+			clear();
+			f12_ = f12;
+			for(i32 i = 0; i < 256; i++) {
+				if(index[i] != 0xFFFF) pages_[i] = const_cast<u16*>(pages + (size_t)index[i] * 256);
+			}
+			external_ = true;
+		}
+		
+		// nullptr for pages without any mapped codepoint
+		const u16* page(u32 index) const {return pages_[index] == zeroPage_ ? nullptr : pages_[index];}
+		
+		u16 lookup(u32 codepoint) const {
+			if(codepoint <= 0xFFFF) return pages_[codepoint >> 8][codepoint & 0xFF];
+			
+			// groups are sorted by startCharCode
+			u32 lo = 0, hi = f12_.numGroups;
+			while(lo < hi) {
+				u32 mid = (lo + hi) / 2;
+				u32 at = f12_.groups + mid*12;
+				if(codepoint > f12_.table.be32(at + 4)) lo = mid + 1;
+				else if(codepoint < f12_.table.be32(at)) hi = mid;
+				else return (u16)(f12_.table.be32(at + 8) + codepoint - f12_.table.be32(at));
 			}
+			return 0;
+		}
+		
+		void clear() {
+			for(i32 i = 0; i < 256; i++) {
+				if(pages_[i] != zeroPage_ && !external_) free(pages_[i]);
+				pages_[i] = zeroPage_;
+			}
+			f12_ = format12();
+			external_ = false;
+		}
+	};
 
-			outline.yCoordinates = (i16*) calloc(1, (last_index+1)*2);
-			current_coordinate = 0;
-			prev_coordinate = 0;
-			for(i32 i = 0; i < (last_index+1); ++i) {
-				i32 flag_combined = outline.flags[i].y_short << 1 | outline.flags[i].y_short_pos;
-				switch(flag_combined) {
-					case 0: {
-						current_coordinate = READ_BE16_MOVE(glyph_start);
-					} break;
-					case 1: { current_coordinate = 0; }break;
-					case 2: { current_coordinate = (*glyph_start++)*-1; }break;
-					case 3: { current_coordinate = (*glyph_start++); } break;
+	// heap allocations so far: the blocks of every MemoryArena, plus every operator new when
+	// MPWS_COUNT_ALLOCATIONS is defined where the implementation gets compiled. reading it
+	// before and after a frame shows whether a code path touches the heap at all
+	std::atomic<size_t> mpws_allocation_count(0);
+	size_t mpws_heap_allocations() {return mpws_allocation_count.load(std::memory_order_relaxed);}
+	
+	#ifdef MPWS_COUNT_ALLOCATIONS
+	void* operator new(size_t size) {
+		mpws_allocation_count.fetch_add(1, std::memory_order_relaxed);
+		void* p = malloc(size ? size : 1);
+		if(!p) throw std::bad_alloc();
+		return p;
+	}
+	void operator delete(void* p) noexcept {free(p);}
+	void operator delete(void* p, size_t) noexcept {free(p);}
+	#endif
+	
+	// bump allocator over malloced blocks, memory is handed out zeroed like calloc and only
+	// given back all at once. rewinding to the start keeps the memory, merged into one block
+	// as big as everything used so far, so a workload that repeats stops touching the heap
+	class MemoryArena {
+	private:
+		typedef struct {
+			u8* data;
+			size_t size;
+		} Block;
+		
+		std::vector<Block> blocks_;
+		size_t current_ = 0; // block being filled
+		size_t used_ = 0;    // bytes used in it
+		size_t blockSize_;
+		
+		void merge() {
+			size_t total = 0;
+			for(const Block& b : blocks_) {
+				total += b.size;
+				free(b.data);
+			}
+			blocks_.resize(1);
+			blocks_[0].data = (u8*) malloc(total);
+			blocks_[0].size = total;
+			mpws_allocation_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		
+	public:
+		typedef struct {
+			size_t block;
+			size_t used;
+		} Mark;
+		
+		MemoryArena(size_t blockSize = 64 << 10): blockSize_(blockSize) {}
+		~MemoryArena() {release();}
+		
+		MemoryArena(const MemoryArena&) = delete;
+		MemoryArena& operator=(const MemoryArena&) = delete;
+		
+		void* allocate(size_t bytes, size_t align) {
+			for(;;) {
+				if(current_ < blocks_.size()) {
+					size_t start = (used_ + align - 1) & ~(align - 1);
+					if(start + bytes <= blocks_[current_].size) {
+						used_ = start + bytes;
+						u8* p = blocks_[current_].data + start;
+						memset(p, 0, bytes);
+						return p;
+					}
+					if(current_ + 1 < blocks_.size()) {
+						current_++;
+						used_ = 0;
+						continue;
+					}
 				}
-
-				outline.yCoordinates[i] = current_coordinate + prev_coordinate;
-				prev_coordinate = outline.yCoordinates[i];
+				Block b;
+				b.size = std::max(blockSize_, bytes + align);
+				b.data = (u8*) malloc(b.size);
+				if(!b.data) throw std::bad_alloc();
+				mpws_allocation_count.fetch_add(1, std::memory_order_relaxed);
+				blocks_.push_back(b);
+				current_ = blocks_.size() - 1;
+				used_ = 0;
 			}
-
-			return outline;
 		}
 		
-		void tessellate_bezier(Floint2D *output, i32 *output_size, Floint2D p0, Floint2D p1, Floint2D p2) {
-			i32 subdiv_into = 5;
-			f32 step_per_iter = 1.0/subdiv_into;
-			i32 out_size = 0;
-			output[out_size++] = p0;
-			for(int i = 1; i <= subdiv_into; i++) {
-				f32 t = i*step_per_iter;
-				f32 t1 = (1.0 - t);
-				f32 t2 = t*t;
-				f32 x = t1*t1*p0.x + 2*t1*t*p1.x + t2*p2.x;
-				f32 y = t1*t1*p0.y + 2*t1*t*p1.y + t2*p2.y;
-				output[out_size].x = x;
-				output[out_size].y = y;
-				out_size++;
+		template<class T> T* push(size_t count) {return (T*) allocate(sizeof(T) * count, alignof(T));}
+		
+		Mark mark() const {
+			Mark m = {current_, used_};
+			return m;
+		}
+		
+		// frees everything allocated after the mark
+		void rewind(Mark m) {
+			current_ = m.block;
+			used_ = m.used;
+			if(current_ == 0 && used_ == 0 && blocks_.size() > 1) merge();
+		}
+		
+		void reset() {rewind(Mark{0, 0});}
+		
+		void release() {
+			for(const Block& b : blocks_) free(b.data);
+			blocks_.clear();
+			current_ = 0;
+			used_ = 0;
+		}
+		
+		size_t capacity() const {
+			size_t total = 0;
+			for(const Block& b : blocks_) total += b.size;
+			return total;
+		}
+	};
+	
+	// rewinds an arena to where it was when the scope started
+	struct ArenaScope {
+		MemoryArena& arena;
+		MemoryArena::Mark mark;
+		
+		ArenaScope(MemoryArena& arena): arena(arena), mark(arena.mark()) {}
+		~ArenaScope() {arena.rewind(mark);}
+	};
+	
+	// decoded glyph outlines keyed by unicode codepoint, open addressing with linear probing.
+	// outlines are only ever added while a font is loaded so there is no need for tombstones
+	class GlyphOutlineMap {
+	private:
+		typedef struct {
+			u32 codepoint;
+			glyph_outline* outline;
+		} Slot;
+		
+		static const u32 emptySlot = 0xFFFFFFFFu; // not a valid codepoint
+		
+		Slot* slots_ = nullptr;
+		u32 capacity_ = 0; // always a power of 2
+		u32 count_ = 0;
+		
+		static u32 hash(u32 codepoint) {
+			codepoint *= 0x9E3779B1u;
+			return codepoint ^ (codepoint >> 16);
+		}
+		
+		Slot* probe(u32 codepoint) const {
+			u32 mask = capacity_ - 1;
+			for(u32 i = hash(codepoint) & mask; ; i = (i + 1) & mask) {
+				if(slots_[i].codepoint == codepoint || slots_[i].codepoint == emptySlot) return slots_ + i;
 			}
+		}
+		
+		void rehash(u32 capacity) {
+			Slot* old = slots_;
+			u32 oldCapacity = capacity_;
 			
-			*output_size = out_size;
+			slots_ = (Slot*) malloc(sizeof(Slot) * capacity);
+			capacity_ = capacity;
+			for(u32 i = 0; i < capacity; i++) slots_[i].codepoint = emptySlot;
+			
+			for(u32 i = 0; i < oldCapacity; i++) {
+				if(old[i].codepoint != emptySlot) *probe(old[i].codepoint) = old[i];
+			}
+			free(old);
 		}
+		
+	public:
+		GlyphOutlineMap() {}
+		~GlyphOutlineMap() {clear(); free(slots_);}
+		
+		GlyphOutlineMap(const GlyphOutlineMap&) = delete;
+		GlyphOutlineMap& operator=(const GlyphOutlineMap&) = delete;
+		
+		glyph_outline* find(u32 codepoint) const {
+			if(count_ == 0 || codepoint == emptySlot) return nullptr;
+			Slot* slot = probe(codepoint);
+			return slot->codepoint == codepoint ? slot->outline : nullptr;
+		}
+		
+		// outlines belong to the font's arena, the map only stores the pointers so they
+		// never move when the table grows. the first outline of a codepoint wins
+		glyph_outline* insert(u32 codepoint, glyph_outline* outline) {
+			// keep the load factor under 3/4
+			if((count_ + 1) * 4 > capacity_ * 3) rehash(capacity_ ? capacity_ * 2 : 128);
+			
+			Slot* slot = probe(codepoint);
+			if(slot->codepoint != codepoint) {
+				slot->codepoint = codepoint;
+				slot->outline = outline;
+				count_++;
+			}
+			return slot->outline;
+		}
+		
+		void clear() {
+			for(u32 i = 0; i < capacity_; i++) {
+				slots_[i].codepoint = emptySlot;
+			}
+			count_ = 0;
+		}
+		
+		u32 count() const {return count_;}
+	};
 
-		void generate_points(glyph_outline *outline, Floint2D *generated_points, i32 *point_count, i32 *gen_pts_end_indices) {
-			i32 j = 0;      // global index for the outline points
-			i32 index = 0;  // index for generated_points
-
-			// Process each contour
-			for (i32 i = 0; i < outline->numberOfContours; i++) {
-				i32 contour_start_index = j;
-				i32 generated_points_start_index = index;
-				bool contour_started_off = false;
-				// The endPtsOfContours array holds the last valid index (inclusive) for the contour.
-				i32 contour_end = outline->endPtsOfContours[i];
-
-				// Process points in the current contour
-				// Loop through inclusive indices of this contour.
-				for (; j <= contour_end; j++) {
-					// Compute next index with wrap–around within the current contour.
-					// If we are at the end, wrap back to the start of the contour.
-					i32 next_index = (j < contour_end) ? (j + 1) : contour_start_index;
+	// the raw bytes of a font file, memory mapped read only where possible so the pages
+	// are shared with every other process using the same font and opening is instant,
+	// falls back to reading the whole file when mapping is not possible
+	class FontSource {
+	private:
+		const u8* data_ = nullptr;
+		size_t size_ = 0;
+		bool mapped_ = false;
+	#if defined(UTIL_WIN32)
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = NULL;
+	#endif
+	
+		bool map(const i8* path) {
+		#if defined(UTIL_WIN32)
+			file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(file_ == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER size;
+			if(!GetFileSizeEx(file_, &size) || size.QuadPart == 0) return false;
+			mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(mapping_ == NULL) return false;
+			void* view = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+			if(view == NULL) return false;
+			size_ = (size_t)size.QuadPart;
+		#else
+			i32 fd = ::open(path, O_RDONLY);
+			if(fd < 0) return false;
+			struct stat st;
+			if(fstat(fd, &st) != 0 || st.st_size == 0) {::close(fd); return false;}
+			void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd); // the mapping keeps the file alive
+			if(view == MAP_FAILED) return false;
+			size_ = (size_t)st.st_size;
+		#endif
+			data_ = (const u8*)view;
+			mapped_ = true;
+			return true;
+		}
+		
+		bool read(const i8* path) {
+			FILE* file = fopen(path, "rb");
+			if(!file) return false;
+			fseek(file, 0, SEEK_END);
+			long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+			
+			u8* content = size > 0 ? (u8*)malloc(size) : NULL;
+			if(content && fread(content, size, 1, file) == 1) {
+				data_ = content;
+				size_ = (size_t)size;
+				fclose(file);
+				return true;
+			}
+			free(content);
+			fclose(file);
+			return false;
+		}
+		
+	public:
+		FontSource() {}
+		~FontSource() {close();}
+		
+		FontSource(const FontSource&) = delete;
+		FontSource& operator=(const FontSource&) = delete;
+		
+		bool open(const i8* path) {
+			close();
+			if(path == NULL || strlen(path) == 0) return false;
+			if(map(path)) return true;
+			close();
+			return read(path);
+		}
+		
+		void close() {
+		#if defined(UTIL_WIN32)
+			if(mapped_ && data_) UnmapViewOfFile(data_);
+			if(mapping_ != NULL) CloseHandle(mapping_);
+			if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+			mapping_ = NULL;
+			file_ = INVALID_HANDLE_VALUE;
+		#else
+			if(mapped_ && data_) munmap((void*)data_, size_);
+		#endif
+			if(!mapped_) free((void*)data_);
+			data_ = nullptr;
+			size_ = 0;
+			mapped_ = false;
+		}
+		
+		// fonts bigger than 4 GiB are not valid TrueType anyway (offsets are 32 bit)
+		BEView view() const {return BEView(data_, size_ > 0xFFFFFFFFu ? 0xFFFFFFFFu : (u32)size_);}
+		bool isOpen() const {return data_ != nullptr;}
+		bool isMapped() const {return mapped_;}
+		size_t size() const {return size_;}
+	};
 
-					// Get current point data.
-					glyph_flag flag = outline->flags[j];
-					i32 x = outline->xCoordinates[j];
-					i32 y = outline->yCoordinates[j];
+	// font cache files are written by Window_common::writeFontCache in the byte order and
+	// struct layout of the machine that wrote them, everything is addressed by file offsets
+	// so a mapped file gets used in place
+	#define FONT_CACHE_MAGIC FONT_TAG('M', 'P', 'W', 'C')
+	#define FONT_CACHE_VERSION 2
+	
+	typedef struct {
+		u32 magic;
+		u32 version;
+		u32 byteOrder;   // 0x01020304 as written
+		u32 recordSizes; // sizeof(font_cache_glyph) << 16 | sizeof(font_cache_bitmap)
+		uint64_t fontKey; // font_checksum of the font the cache was built from
+		u32 fileSize;
+		u32 rasterizer;   // GLYPH_RASTERIZER, channels and flattenTolerance the bitmaps were made with
+		u32 channels;
+		f32 flattenTolerance;
+		u32 cmapIndex;    // u16[256] page numbers, 0xFFFF for empty pages
+		u32 cmapPages;    // u16[256] per page
+		u32 cmapPageCount;
+		u32 glyphs;       // font_cache_glyph[glyphCount] sorted by codepoint
+		u32 glyphCount;
+		u32 bitmaps;      // font_cache_bitmap[bitmapCount] sorted by key
+		u32 bitmapCount;
+	} font_cache_header;
+	
+	typedef struct {
+		u32 codepoint;
+		u16 contours;
+		i16 xMin, yMin, xMax, yMax;
+		u32 points;     // f32[pointCount] x then f32[pointCount] y in font units
+		u32 pointCount;
+		u32 ends;       // i32[contours], exclusive ends into points
+		f32 pixelsPerEm; // largest size the points are fine enough for
+	} font_cache_glyph;
+	
+	typedef struct {
+		uint64_t key;   // size << 32 | codepoint
+		i32 width, height;
+		i32 left, bottom;
+		i32 channels;
+		u32 coverage;   // width*channels*height bytes, rows bottom up
+	} font_cache_bitmap;
+	
+	// read side of a font cache file, open only accepts files written for the same font
+	// by this build, checks every table against the file size and that the lookup tables
+	// are sorted, entries get checked when they are looked up
+	class FontCacheFile {
+	private:
+		FontSource file_;
+		const font_cache_header* header_ = nullptr;
+		
+		const u8* base() const {return (const u8*)header_;}
+		bool fits(u32 offset, uint64_t bytes) const {return (uint64_t)offset + bytes <= header_->fileSize;}
+		
+	public:
+		bool open(const i8* path, uint64_t fontKey) {
+			close();
+			if(!file_.open(path)) return false;
+			
+			const font_cache_header* h = (const font_cache_header*)file_.view().data;
+			bool valid = file_.size() >= sizeof(font_cache_header) &&
+				((uintptr_t)h & 7) == 0 &&
+				h->magic == FONT_CACHE_MAGIC && h->version == FONT_CACHE_VERSION &&
+				h->byteOrder == 0x01020304 &&
+				h->recordSizes == (u32)(sizeof(font_cache_glyph) << 16 | sizeof(font_cache_bitmap)) &&
+				h->fontKey == fontKey && h->fileSize == file_.size();
+			header_ = h;
+			valid = valid && fits(h->cmapIndex, 256 * sizeof(u16)) &&
+				fits(h->cmapPages, (uint64_t)h->cmapPageCount * 256 * sizeof(u16)) &&
+				fits(h->glyphs, (uint64_t)h->glyphCount * sizeof(font_cache_glyph)) &&
+				fits(h->bitmaps, (uint64_t)h->bitmapCount * sizeof(font_cache_bitmap)) &&
+				h->cmapIndex % 2 == 0 && h->cmapPages % 2 == 0 && h->glyphs % 8 == 0 && h->bitmaps % 8 == 0;
+			if(valid) {
+				const u16* index = cmapIndex();
+				for(i32 i = 0; i < 256 && valid; i++) valid = index[i] == 0xFFFF || index[i] < h->cmapPageCount;
+				
+				// both get binary searched
+				const font_cache_glyph* glyphs = (const font_cache_glyph*)(base() + h->glyphs);
+				for(u32 i = 1; i < h->glyphCount && valid; i++) valid = glyphs[i-1].codepoint < glyphs[i].codepoint;
+				const font_cache_bitmap* bitmaps = (const font_cache_bitmap*)(base() + h->bitmaps);
+				for(u32 i = 1; i < h->bitmapCount && valid; i++) valid = bitmaps[i-1].key < bitmaps[i].key;
+			}
+			if(!valid) close();
+			return valid;
+		}
+		
+		void close() {
+			file_.close();
+			header_ = nullptr;
+		}
+		
+		bool isOpen() const {return header_ != nullptr;}
+		const font_cache_header* header() const {return header_;}
+		const u16* cmapIndex() const {return (const u16*)(base() + header_->cmapIndex);}
+		const u16* cmapPages() const {return (const u16*)(base() + header_->cmapPages);}
+		
+		const font_cache_glyph* glyph(u32 codepoint) const {
+			if(!header_) return nullptr;
+			const font_cache_glyph* first = (const font_cache_glyph*)(base() + header_->glyphs);
+			const font_cache_glyph* last = first + header_->glyphCount;
+			const font_cache_glyph* it = std::lower_bound(first, last, codepoint,
+				[](const font_cache_glyph& g, u32 c) {return g.codepoint < c;});
+			if(it == last || it->codepoint != codepoint) return nullptr;
+			if(!fits(it->points, (uint64_t)it->pointCount * 2 * sizeof(f32)) || !fits(it->ends, (uint64_t)it->contours * sizeof(i32)) ||
+			   it->points % 4 || it->ends % 4) return nullptr;
+			
+			// edge buffers get sized from the last end and points indexed by all of them
+			const i32* contourEnds = ends(it);
+			for(u32 i = 0; i < it->contours; i++) {
+				if(contourEnds[i] <= (i ? contourEnds[i-1] : 0) || (u32)contourEnds[i] > it->pointCount) return nullptr;
+			}
+			return it;
+		}
+		
+		const f32* points(const font_cache_glyph* g) const {return (const f32*)(base() + g->points);}
+		const i32* ends(const font_cache_glyph* g) const {return (const i32*)(base() + g->ends);}
+		
+		const font_cache_bitmap* bitmap(u32 codepoint, i32 size) const {
+			if(!header_ || header_->bitmapCount == 0) return nullptr;
+			uint64_t key = ((uint64_t)(u32)size << 32) | codepoint;
+			const font_cache_bitmap* first = (const font_cache_bitmap*)(base() + header_->bitmaps);
+			const font_cache_bitmap* last = first + header_->bitmapCount;
+			const font_cache_bitmap* it = std::lower_bound(first, last, key,
+				[](const font_cache_bitmap& b, uint64_t k) {return b.key < k;});
+			if(it == last || it->key != key) return nullptr;
+			if(it->width < 0 || it->height < 0 || it->channels < 1 ||
+			   !fits(it->coverage, (uint64_t)it->width * it->channels * it->height)) return nullptr;
+			return it;
+		}
+		
+		const u8* coverage(const font_cache_bitmap* b) const {return base() + b->coverage;}
+	};
 
-					if (flag.on_curve) {
+	// decodes one codepoint and advances text past it, malformed or overlong
+	// sequences become U+FFFD and consume a single byte so decoding always resyncs
+	inline u32 utf8_next(const i8** text) {
+		const u8* s = (const u8*)*text;
+		u32 c = s[0];
+		i32 n = c < 0x80 ? 0 : c < 0xC2 ? -1 : c < 0xE0 ? 1 : c < 0xF0 ? 2 : c < 0xF5 ? 3 : -1;
+		if(n < 0) {*text += 1; return 0xFFFD;}
+		
+		c &= 0x7F >> n;
+		for(i32 i = 1; i <= n; i++) {
+			if((s[i] & 0xC0) != 0x80) {*text += 1; return 0xFFFD;}
+			c = (c << 6) | (s[i] & 0x3F);
+		}
+		if((n == 2 && c < 0x800) || (n == 3 && c < 0x10000) || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+			*text += 1;
+			return 0xFFFD;
+		}
+		*text += n + 1;
+		return c;
+	}
+	
+	// glyph of a laid out string, position of its pen relative to the start of the run
+	typedef struct {
+		u32 codepoint;
+		i32 x, y;
+	} shaped_glyph;
+	
+	typedef struct {
+		std::string text;
+		i16 size;
+		i32 width;  // advance of the widest line
+		i32 height; // distance from the first to the last baseline
+		std::vector<shaped_glyph> glyphs; // only glyphs with an outline, spaces just advance
+	} shaped_run;
+	
+	// laid out strings keyed by (text, size) so labels drawn every frame skip decoding,
+	// cmap lookups and kerning, lookups hash the bytes in place and never build a key.
+	// runs are shared so one dropped from the cache stays alive while someone draws it
+	class ShapedRunCache {
+	private:
+		std::unordered_multimap<uint64_t, std::shared_ptr<shaped_run>> runs_;
+		size_t capacity_;
+		
+		static uint64_t hash(const i8* text, size_t length, i16 size) {
+			uint64_t h = 14695981039346656037ull ^ (u16)size;
+			for(size_t i = 0; i < length; i++) {
+				h ^= (u8)text[i];
+				h *= 1099511628211ull;
+			}
+			return h;
+		}
+		
+	public:
+		ShapedRunCache(size_t capacity = 1024): capacity_(capacity) {}
+		
+		std::shared_ptr<shaped_run> find(const i8* text, size_t length, i16 size) const {
+			auto range = runs_.equal_range(hash(text, length, size));
+			for(auto it = range.first; it != range.second; ++it) {
+				const shaped_run& run = *it->second;
+				if(run.size == size && run.text.size() == length && memcmp(run.text.data(), text, length) == 0) return it->second;
+			}
+			return nullptr;
+		}
+		
+		// the whole cache is dropped once it holds capacity runs since labels tend to be
+		// either stable or one-off
+		void insert(std::shared_ptr<shaped_run> run) {
+			if(runs_.size() >= capacity_) runs_.clear();
+			uint64_t key = hash(run->text.data(), run->text.size(), run->size);
+			runs_.emplace(key, std::move(run));
+		}
+		
+		void clear() {runs_.clear();}
+		size_t count() const {return runs_.size();}
+	};
+	
+	// a loaded font with its outlines, bitmaps and layouts, shared between windows and
+	// threads through std::shared_ptr and drawn into any Raster. once loaded, shaping,
+	// rasterizing and drawing may run on many threads at once: outlines and bitmaps live
+	// in shards with a lock each so threads rarely meet, the scratch memory is per thread
+	// and shaped runs are handed out as shared pointers. loadFont and the set* settings
+	// are not synchronized, configure a face before sharing it
+	class FontFace {
+	private:
+		static const u32 outlineShardCount = 16;
+		static const u32 bitmapShardCount = 8;
+		
+		typedef struct {
+			std::mutex lock;
+			GlyphOutlineMap outlines;
+		} outline_shard;
+		
+		typedef struct {
+			std::mutex lock;
+			GlyphCache bitmaps;
+		} bitmap_shard;
+		
+		// working memory of the calling thread, every face shares it since a thread only
+		// rasterizes one glyph at a time
+		typedef struct {
+			raster_scratch raster;
+			MemoryArena frame; // short lived text scratch, every user rewinds it when done
+			std::vector<raster_scratch> workers; // one per rasterizer thread of rasterizeGlyphs
+			std::vector<u8> letterCoverage;
+			glyph_bitmap letter;
+		} thread_scratch;
+		
+		static thread_scratch& scratch() {
+			static thread_local thread_scratch s;
+			return s;
+		}
+		
+		outline_shard& outlineShard(u32 codepoint) {return outlineShards_[(codepoint * 0x9E3779B1u) >> 28];}
+		bitmap_shard& bitmapShard(u32 codepoint, i16 size) {
+			return bitmapShards_[((codepoint ^ (u32)size * 0x85EBCA6Bu) * 0x9E3779B1u) >> 29];
+		}
+		
+	public:
+		// Parsed TrueType tables
+		FontSource fontFile_;
+		font_directory  fontDir_;
+		head_table head_ = {};
+		os2_table os2_ = {};
+		hhea_table hhea_ = {};
+		BEView loca_;
+		BEView kernPairs_; // format 0 pairs of the first horizontal kern subtable
+		u16 kernPairCount_ = 0;
+		
+		u16 cmapSegCount_ = 0;
+		CmapLookup cmap_;
+		FontCacheFile fontCache_;
+
+		// Scaling
+		f32 scale_ = 1.0f;
+		f32 baselinePx_ = 0.0f;
+		u16 unitsPerEm_ = 0;
+		
+		// Glyph outlines, decoded the first time a codepoint gets drawn
+		outline_shard outlineShards_[outlineShardCount];
+		MemoryArena outlineArena_;  // outlines and their arrays of the loaded font
+		std::mutex outlineArenaLock_; // guards outlineArena_ and the flat pointer of every outline
+		
+		// Cached letter bitmaps based of font size and character index
+		bitmap_shard bitmapShards_[bitmapShardCount];
+		GLYPH_RASTERIZER glyphRasterizer_ = MPWS_RASTER_AREA;
+		bool subpixelText_ = false; // lcd masks for horizontal rgb stripes, not used by MPWS_RASTER_SDF
+		bool linearText_ = false;   // blend text in linear light through textGamma_
+		text_gamma textGamma_;
+		f32 flattenTolerance_ = 0.2f; // max distance in pixels between a curve and its line segments
+		std::unordered_map<u32, glyph_sdf> glyphSdfs_; // built once per codepoint, sampled at any size
+		std::mutex sdfLock_;
+		i16 sdfSize_ = 48;      // pixels per em of the distance fields
+		f32 sdfSpread_ = 4.0f;  // reference pixels the field reaches past the outline
+		
+		ShapedRunCache shapedRuns_;
+		std::mutex runLock_;
+		std::atomic<u32> generation_; // bumped whenever every bitmap gets dropped
+		
+		FontFace(): generation_(0) {setGlyphCacheBudget(4 << 20);}
+		explicit FontFace(const i8* path, const i8* cachePath = nullptr): FontFace() {loadFont(path, cachePath);}
+		
+		FontFace(const FontFace&) = delete;
+		FontFace& operator=(const FontFace&) = delete;
+		
+		bool isLoaded() const {return fontFile_.isOpen();}
+		
+		// the budget is split evenly between the shards
+		void setGlyphCacheBudget(size_t bytes) {
+			for(bitmap_shard& shard : bitmapShards_) {
+				std::lock_guard<std::mutex> lock(shard.lock);
+				shard.bitmaps.setBudget(bytes / bitmapShardCount);
+			}
+		}
+		
+		void clearBitmaps() {
+			for(bitmap_shard& shard : bitmapShards_) {
+				std::lock_guard<std::mutex> lock(shard.lock);
+				shard.bitmaps.clear();
+			}
+			generation_++;
+		}
+		
+		// changes whenever the font or a setting that shapes the glyphs changes, anything built
+		// out of the bitmaps is stale once it does
+		u32 generation() const {return generation_;}
+		
+		void clearOutlines() {
+			for(outline_shard& shard : outlineShards_) {
+				std::lock_guard<std::mutex> lock(shard.lock);
+				shard.outlines.clear();
+			}
+		}
+		
+		
+		// picks the format 4 (BMP) and format 12 (full unicode) subtables, preferring unicode
+		// encodings over the others, the arrays are read in place later
+		void read_cmap(BEView mem, format4* f4, format12* f12) {
+			bool f4Unicode = false, f12Unicode = false;
+			u16 numberSubtables = mem.be16(2);
+			for(i32 i = 0; i < numberSubtables; ++i) {
+				cmap_encoding_subtable est;
+				est.platformID = mem.be16(4 + i*8);
+				est.platformSpecificID = mem.be16(6 + i*8);
+				est.offset = mem.be32(8 + i*8);
+				
+				bool unicode = est.platformID == 0 ||
+					(est.platformID == 3 && (est.platformSpecificID == 1 || est.platformSpecificID == 10));
+				
+				u16 format = mem.be16(est.offset);
+				if(format == 4 && (!f4->table.valid() || (unicode && !f4Unicode))) {
+					read_format4(mem.sub(est.offset), f4);
+					f4Unicode = unicode;
+				} else if(format == 12 && (!f12->table.valid() || (unicode && !f12Unicode))) {
+					read_format12(mem.sub(est.offset), f12);
+					f12Unicode = unicode;
+				}
+			}
+		}
+		
+		void read_format12(BEView mem, format12* f) {
+			f->table = mem.sub(0, mem.be32(4));
+			f->numGroups = f->table.be32(12);
+			f->groups = 16;
+			// a broken group count must not make the binary search read garbage
+			if(!f->table.has(f->groups, f->numGroups * 12) || f->numGroups > 0x10000000u) f->numGroups = 0;
+		}
+		
+		void read_format4(BEView mem, format4* f) {
+			u16 length = mem.be16(2);
+			
+			f->table = mem.sub(0, length);
+			f->segCountX2 = f->table.be16(6);
+			
+			f->endCode = 14;
+			f->startCode = f->endCode + f->segCountX2 + 2; // skip reservedPad
+			f->idDelta = f->startCode + f->segCountX2;
+			f->idRangeOffset = f->idDelta + f->segCountX2;
+			f->glyphIdArray = f->idRangeOffset + f->segCountX2;
+		}
+		
+		void read_offset_subtable(BECursor& mem, offset_subtable* off_sub) {
+			off_sub->scaler_type = mem.next32();
+			off_sub->numTables = mem.next16();
+			off_sub->searchRange = mem.next16();
+			off_sub->entrySelector = mem.next16();
+			off_sub->rangeShift = mem.next16();
+		}
+		
+		void read_table_directory(BEView file, BECursor& mem, font_directory* ft) {
+			for(i32 i = 0; i < ft->off_sub.numTables; ++i) {
+				table_directory t;
+				t.tag = mem.next32();
+				t.checkSum = mem.next32();
+				t.offset = mem.next32();
+				t.length = mem.next32();
+				
+				BEView table = file.sub(t.offset, t.length);
+				switch(t.tag) {
+					case GLYF_TAG: ft->glyf = table; break;
+					case LOCA_TAG: ft->loca = table; break;
+					case HEAD_TAG: ft->head = table; break;
+					case CMAP_TAG: {
+						ft->cmap = table;
+						read_cmap(table, &ft->f4, &ft->f12);
+					} break;
+					case OS2_TAG:  ft->os2  = table; break;
+					case HHEA_TAG: ft->hhea = table; break;
+					case HMTX_TAG: ft->hmtx = table; break;
+					case KERN_TAG: ft->kern = table; break;
+				}
+			}
+		}
+		
+		void read_font_directory(BEView file, BECursor& mem, font_directory* ft) {
+			read_offset_subtable(mem, &ft->off_sub); 
+			read_table_directory(file, mem, ft);
+		}
+		
+		i32 read_loca_type(font_directory* ft) {
+			return ft->head.be16(50);
+		}
+		
+		void parseTables() {
+			// Head table must have been set by read_font_directory
+			if (!fontDir_.head.valid())
+				throw std::runtime_error("No head table found");
+			BEView head = fontDir_.head;
+			head_.majorVersion = head.be16(0);
+			head_.minorVersion = head.be16(2);
+			head_.checkSumAdjustment = head.be32(8);
+			head_.magicNumber = head.be32(12);
+			head_.flags = head.be16(16);
+			head_.unitsPerEm = head.be16(18);
+			head_.xMin = head.bei16(36);
+			head_.yMin = head.bei16(38);
+			head_.xMax = head.bei16(40);
+			head_.yMax = head.bei16(42);
+			head_.macStyle = head.be16(44);
+			head_.lowestRecPPEM = head.be16(46);
+			head_.fontDirectionHint = head.bei16(48);
+			head_.indexToLocFormat = head.bei16(50);
+			head_.glyphDataFormat = head.bei16(52);
+
+			// OS/2 table pointer
+			if (!fontDir_.os2.valid())
+				throw std::runtime_error("No OS/2 table found");
+			BEView os2 = fontDir_.os2;
+			os2_.version = os2.be16(0);
+			os2_.sTypoAscender = os2.bei16(68);
+			os2_.sTypoDescender = os2.bei16(70);
+			os2_.sTypoLineGap = os2.bei16(72);
+			os2_.usWinAscent = os2.be16(74);
+			os2_.usWinDescent = os2.be16(76);
+			
+			// horizontal metrics, without them every glyph advances by its width
+			BEView hhea = fontDir_.hhea;
+			hhea_.ascender = hhea.bei16(4);
+			hhea_.descender = hhea.bei16(6);
+			hhea_.lineGap = hhea.bei16(8);
+			hhea_.advanceWidthMax = hhea.be16(10);
+			hhea_.numberOfHMetrics = hhea.be16(34);
+			if(!hhea.valid()) {
+				hhea_.ascender = os2_.sTypoAscender;
+				hhea_.descender = os2_.sTypoDescender;
+				hhea_.lineGap = os2_.sTypoLineGap;
+			}
+			
+			// old style kern table, only the first horizontal format 0 subtable is used
+			kernPairs_ = BEView();
+			kernPairCount_ = 0;
+			BEView kern = fontDir_.kern;
+			u32 offset = 4;
+			for(u16 i = 0, n = kern.be16(2); kern.be16(0) == 0 && i < n; i++) {
+				u16 length = kern.be16(offset + 2);
+				u16 coverage = kern.be16(offset + 4);
+				// format 0, horizontal, not minimum values, not cross stream
+				if(length >= 14 && (coverage & 0xFF07) == 0x0001) {
+					kernPairCount_ = kern.be16(offset + 6);
+					kernPairs_ = kern.sub(offset + 14, kernPairCount_ * 6);
+					break;
+				}
+				offset += length;
+			}
+			
+			// OS/2 table pointer
+			if (!fontDir_.loca.valid())
+				throw std::runtime_error("No loca table found");
+			loca_ = fontDir_.loca;
+
+			// cmap format4 data prepared in read_font_directory, the lookup table itself
+			// gets built in loadFont unless a font cache provides it
+			cmapSegCount_ = fontDir_.f4.segCountX2 / 2;
+		}
+		
+		// identifies a font file for font caches: the size and every table record, whose
+		// checksums cover all of the font data
+		uint64_t font_checksum(BEView file) {
+			uint64_t h = 14695981039346656037ull;
+			auto mix = [&h](u32 v) {
+				for(i32 i = 0; i < 4; i++) {
+					h ^= (v >> (i*8)) & 0xFF;
+					h *= 1099511628211ull;
+				}
+			};
+			mix(file.size);
+			u16 numTables = file.be16(4);
+			mix(numTables);
+			for(u32 i = 0; i < numTables; i++) {
+				for(u32 field = 0; field < 16; field += 4) mix(file.be32(12 + i*16 + field));
+			}
+			return h;
+		}
+		
+		// advance width in font units
+		i32 get_advance(u32 glyph_index) {
+			u16 n = hhea_.numberOfHMetrics;
+			if(n == 0) return hhea_.advanceWidthMax;
+			// glyphs past numberOfHMetrics share the last advance
+			if(glyph_index >= n) glyph_index = n - 1;
+			return fontDir_.hmtx.be16(glyph_index * 4);
+		}
+		
+		// pair adjustment in font units, pairs are sorted by (left << 16 | right)
+		i32 get_kerning(u32 left, u32 right) {
+			u32 key = (left << 16) | (right & 0xFFFF);
+			i32 lo = 0, hi = (i32)kernPairCount_ - 1;
+			while(lo <= hi) {
+				i32 mid = (lo + hi) >> 1;
+				u32 pair = kernPairs_.be32(mid * 6);
+				if(pair < key) lo = mid + 1;
+				else if(pair > key) hi = mid - 1;
+				else return kernPairs_.bei16(mid * 6 + 4);
+			}
+			return 0;
+		}
+		
+		i32 get_glyph_index(u32 code_point) {
+			return cmap_.lookup(code_point);
+		}
+		
+		u32 get_glyph_offset(font_directory *ft, u32 glyph_index) {
+			u32 offset = 0;
+			if(read_loca_type(ft)) {
+				//32 bit
+				offset = ft->loca.be32(glyph_index*4);
+			} else {
+				offset =  ft->loca.be16(glyph_index*2)*2;
+			}
+			return offset;
+		}
+		
+		// the arrays are carved out of arena and live until it gets reset
+		glyph_outline get_glyph_outline(font_directory* ft, u32 glyph_index, MemoryArena& arena) {
+			u32 offset = get_glyph_offset(ft, glyph_index);
+			glyph_outline outline = {0};
+			// glyphs without an outline (like space) have no data, loca repeats their offset
+			if(get_glyph_offset(ft, glyph_index + 1) <= offset) return outline;
+			
+			BECursor glyph(ft->glyf.sub(offset));
+			outline.numberOfContours = glyph.next16();
+			outline.xMin = glyph.next16();
+			outline.yMin = glyph.next16();
+			outline.xMax = glyph.next16();
+			outline.yMax = glyph.next16();
+			
+			// empty and composite (negative contour count) glyphs have no outline of their own
+			if((i16)outline.numberOfContours <= 0) {
+				outline.numberOfContours = 0;
+				return outline;
+			}
+
+			outline.endPtsOfContours = arena.push<u16>(outline.numberOfContours);
+			for(i32 i = 0; i < outline.numberOfContours; ++i) {
+				outline.endPtsOfContours[i] = glyph.next16();
+			}
+
+			outline.instructionLength = glyph.next16();
+			outline.instructions = arena.push<u8>(outline.instructionLength);
+			BEView instructions = glyph.view.sub(glyph.pos, outline.instructionLength);
+			if(instructions.valid()) memcpy(outline.instructions, instructions.data, instructions.size);
+			glyph.skip(outline.instructionLength);
+
+			i32 last_index = outline.endPtsOfContours[outline.numberOfContours-1];
+			outline.flags = arena.push<glyph_flag>(last_index + 1);
+
+			for(i32 i = 0; i < (last_index + 1); ++i) {
+				outline.flags[i].flag = glyph.next8();
+				if(outline.flags[i].repeat) {
+					u8 repeat_count = glyph.next8();
+					while(repeat_count-- > 0 && i < last_index) {
+						i++;
+						outline.flags[i] = outline.flags[i-1];
+					}
+				}
+			}
+
+
+			outline.xCoordinates = arena.push<i16>(last_index + 1);
+			i16 prev_coordinate = 0;
+			i16 current_coordinate = 0;
+			for(i32 i = 0; i < (last_index+1); ++i) {
+				i32 flag_combined = outline.flags[i].x_short << 1 | outline.flags[i].x_short_pos;
+				switch(flag_combined) {
+					case 0: {
+						current_coordinate = glyph.next16();
+					} break;
+					case 1: { current_coordinate = 0; }break;
+					case 2: { current_coordinate = glyph.next8()*-1; }break;
+					case 3: { current_coordinate = glyph.next8(); } break;
+				}
+
+				outline.xCoordinates[i] = current_coordinate + prev_coordinate;
+				prev_coordinate = outline.xCoordinates[i];
+			}
+
+			outline.yCoordinates = arena.push<i16>(last_index + 1);
+			current_coordinate = 0;
+			prev_coordinate = 0;
+			for(i32 i = 0; i < (last_index+1); ++i) {
+				i32 flag_combined = outline.flags[i].y_short << 1 | outline.flags[i].y_short_pos;
+				switch(flag_combined) {
+					case 0: {
+						current_coordinate = glyph.next16();
+					} break;
+					case 1: { current_coordinate = 0; }break;
+					case 2: { current_coordinate = glyph.next8()*-1; }break;
+					case 3: { current_coordinate = glyph.next8(); } break;
+				}
+
+				outline.yCoordinates[i] = current_coordinate + prev_coordinate;
+				prev_coordinate = outline.yCoordinates[i];
+			}
+
+			return outline;
+		}
+		
+		// number of line segments that keep a quadratic within tolerance device pixels of its chords:
+		// the distance between the curve and a chord over a parameter step h is at most
+		// |p0 - 2p1 + p2| * h^2 / 4, so n = sqrt(|p0 - 2p1 + p2| * scale / (4 * tolerance))
+		i32 bezier_segments(Floint2D p0, Floint2D p1, Floint2D p2, f32 scale, f32 tolerance) {
+			f32 ddx = p0.x - 2*p1.x + p2.x;
+			f32 ddy = p0.y - 2*p1.y + p2.y;
+			f32 deviation = sqrtf(ddx*ddx + ddy*ddy) * scale;
+			i32 segments = (i32)ceilf(sqrtf(deviation / (4*tolerance)));
+			return std::min(std::max(segments, 1), 64);
+		}
+		
+		// appends the points after p0 up to and including p2, p0 is already the last output point
+		void tessellate_bezier(std::vector<Floint2D>& output, Floint2D p0, Floint2D p1, Floint2D p2, i32 subdiv_into) {
+			f32 step_per_iter = 1.0/subdiv_into;
+			for(int i = 1; i <= subdiv_into; i++) {
+				f32 t = i*step_per_iter;
+				f32 t1 = (1.0 - t);
+				f32 t2 = t*t;
+				f32 x = t1*t1*p0.x + 2*t1*t*p1.x + t2*p2.x;
+				f32 y = t1*t1*p0.y + 2*t1*t*p1.y + t2*p2.y;
+				output.push_back(Floint2D(x, y));
+			}
+		}
+
+		// flattens the outline into closed polylines, in font units. Curves are split adaptively so
+		// that at the given scale (pixels per font unit) no chord is further than tolerance pixels
+		// from the curve. generated_points grows as needed so it can be reused between glyphs
+		void generate_points(glyph_outline *outline, std::vector<Floint2D>& generated_points, i32 *gen_pts_end_indices, f32 scale, f32 tolerance) {
+			i32 j = 0;      // global index for the outline points
+			generated_points.clear();
+			
+			auto tessellate = [&](Floint2D p0, Floint2D p1, Floint2D p2) {
+				tessellate_bezier(generated_points, p0, p1, p2, bezier_segments(p0, p1, p2, scale, tolerance));
+			};
+
+			// Process each contour
+			for (i32 i = 0; i < outline->numberOfContours; i++) {
+				i32 contour_start_index = j;
+				i32 generated_points_start_index = generated_points.size();
+				bool contour_started_off = false;
+				// The endPtsOfContours array holds the last valid index (inclusive) for the contour.
+				i32 contour_end = outline->endPtsOfContours[i];
+
+				// Process points in the current contour
+				// Loop through inclusive indices of this contour.
+				for (; j <= contour_end; j++) {
+					// Compute next index with wrap–around within the current contour.
+					// If we are at the end, wrap back to the start of the contour.
+					i32 next_index = (j < contour_end) ? (j + 1) : contour_start_index;
+
+					// Get current point data.
+					glyph_flag flag = outline->flags[j];
+					i32 x = outline->xCoordinates[j];
+					i32 y = outline->yCoordinates[j];
+
+					if (flag.on_curve) {
 						// On–curve: simply add the current point.
-						generated_points[index].x = (f32)x;
-						generated_points[index].y = (f32)y;
-						index++;
+						generated_points.push_back(Floint2D((f32)x, (f32)y));
 					} else {
 						// Off–curve: need to handle differently.
 						if (j == contour_start_index) {
@@ -867,18 +2506,14 @@
 							contour_started_off = true;
 							if (outline->flags[next_index].on_curve) {
 								// If next point is on curve, add that point directly and skip it.
-								generated_points[index].x = (f32)outline->xCoordinates[next_index];
-								generated_points[index].y = (f32)outline->yCoordinates[next_index];
-								index++;
+								generated_points.push_back(Floint2D((f32)outline->xCoordinates[next_index], (f32)outline->yCoordinates[next_index]));
 								j++; // Skip the next point since it was already processed.
 								continue;
 							} else {
 								// Otherwise, compute an implicit on–curve point at the midpoint.
 								x = x + (outline->xCoordinates[next_index] - x) / 2.0;
 								y = y + (outline->yCoordinates[next_index] - y) / 2.0;
-								generated_points[index].x = (f32)x;
-								generated_points[index].y = (f32)y;
-								index++;
+								generated_points.push_back(Floint2D((f32)x, (f32)y));
 							}
 						} else {
 							// For off–curve points after the first point in the contour,
@@ -886,7 +2521,7 @@
 							//   p0: the last generated (on–curve) point,
 							//   p1: the current off–curve point, and
 							//   p2: the next point (or its midpoint if it is off–curve)
-							Floint2D p0 = generated_points[index - 1];
+							Floint2D p0 = generated_points.back();
 							Floint2D p1 = { (f32)x, (f32)y };
 							Floint2D p2 = { (f32)outline->xCoordinates[next_index], (f32)outline->yCoordinates[next_index] };
 
@@ -894,215 +2529,1703 @@
 								// Next point is also off–curve; compute its midpoint with p1.
 								p2.x = p1.x + (p2.x - p1.x) / 2.0;
 								p2.y = p1.y + (p2.y - p1.y) / 2.0;
-							} else {
+							} else if (next_index != contour_start_index) {
 								// Next point is on–curve; advance the point index as it will be handled here.
+								// (the wrapped around start point must not push j into the next contour)
 								j++;
 							}
-							i32 out_size = 0;
 							// Generate points along the Bézier from p0 to p2 with control point p1.
-							tessellate_bezier(generated_points + index, &out_size, p0, p1, p2);
-							index += out_size;
+							tessellate(p0, p1, p2);
 						}
 					}
 				}
 
 				// Close the contour by connecting the final generated point with the start.
 				if (outline->flags[contour_end].on_curve) {
-					generated_points[index] = generated_points[generated_points_start_index];
-					index++;
+					generated_points.push_back(generated_points[generated_points_start_index]);
 				}
 
 				// If the contour started with an off–curve point,
 				// perform an extra tessellation between the last generated point,
 				// the contour’s first point, and the initial generated point.
 				if (contour_started_off) {
-					Floint2D p0 = generated_points[index - 1];
+					Floint2D p0 = generated_points.back();
 					Floint2D p1 = { (f32)outline->xCoordinates[contour_start_index], (f32)outline->yCoordinates[contour_start_index] };
 					Floint2D p2 = generated_points[generated_points_start_index];
-					i32 out_size = 0;
-					tessellate_bezier(generated_points + index, &out_size, p0, p1, p2);
-					index += out_size;
+					tessellate(p0, p1, p2);
 				}
 
 				// Record the end index for generated points of this contour.
-				gen_pts_end_indices[i] = index;
+				gen_pts_end_indices[i] = generated_points.size();
+			}
+		}
+		
+		Line2D* generate_edges(Floint2D *pts_gen, i32 *edge_count, const i32 *contour_ends, i32 contour_count, raster_scratch& scratch) {
+			i32 j = 0;
+			i32 edge_index = 0;
+			scratch.lines.resize(contour_ends[contour_count-1], Line2D(Point2D(0, 0), Point2D(0, 0)));
+			Line2D *edges = scratch.lines.data();
+			for(i32 i = 0; i < contour_count; i++) {
+				for(; j < contour_ends[i]-1; j++) {
+					Line2D *edge = edges + edge_index;
+					edge->p0.x = pts_gen[j].x;
+					edge->p0.y = pts_gen[j].y;
+					
+					edge->p1.x = pts_gen[j+1].x;
+					edge->p1.y = pts_gen[j+1].y;
+					edge_index++;
+				}
+				j++; //we are the end of the contour, skip over this point to the start of the next contour
+			}
+			
+			*edge_count = edge_index;
+
+			return edges;
+		}
+
+		void rasterize_glyph(Line2D *edges, i32 edge_count, u8 *bitmap, i32 bitmap_height, i32 bitmap_width, i32 bitmap_stride) {
+			rasterize_glyph(edges, edge_count, bitmap, bitmap_height, bitmap_width, bitmap_stride, scratch().raster);
+		}
+		
+		// active edge table scanline rasterizer with 5 sub scanlines per row: edges are sorted
+		// by their top once, the active list only changes when the scanline passes an edge end
+		// and stays sorted by x through an insertion sort that is linear for the usual case of
+		// crossings that keep their order from one sub scanline to the next
+		void rasterize_glyph(Line2D *edges, i32 edge_count, u8 *bitmap, i32 bitmap_height, i32 bitmap_width, i32 bitmap_stride, raster_scratch& scratch) {
+			const i32 scanline_subdiv = 5;
+			const f32 alpha_weight = 255.0/scanline_subdiv;
+			const f32 step_per_scanline = 1.0/scanline_subdiv;
+			
+			std::vector<glyph_edge>& table = scratch.edges;
+			std::vector<glyph_edge*>& active = scratch.active;
+			table.clear();
+			active.clear();
+			
+			for(i32 j = 0; j < edge_count; j++) {
+				const Line2D& edge = edges[j];
+				if(edge.p0.y == edge.p1.y) continue;
+				
+				const Point2D& top = edge.p0.y < edge.p1.y ? edge.p0 : edge.p1;
+				const Point2D& bottom = edge.p0.y < edge.p1.y ? edge.p1 : edge.p0;
+				
+				glyph_edge e;
+				e.yTop = top.y;
+				e.yBottom = bottom.y;
+				e.xTop = top.x;
+				e.dxdy = (f32)(bottom.x - top.x) / (f32)(bottom.y - top.y);
+				e.x = top.x;
+				table.push_back(e);
 			}
+			std::sort(table.begin(), table.end(), [](const glyph_edge& a, const glyph_edge& b) {return a.yTop < b.yTop;});
+			
+			size_t next_edge = 0;
+			for(i32 i = 0; i < bitmap_height; i++) {
+				u8* row = bitmap + i*bitmap_stride;
 
-			*point_count = index; // Return the total count of generated points.
+				for(i32 x = 0; x < scanline_subdiv; x++) {
+					f32 scanline = i + x*step_per_scanline;
+					
+					// edges cross the scanline for yTop < scanline <= yBottom
+					while(next_edge < table.size() && table[next_edge].yTop < scanline) {
+						active.push_back(&table[next_edge++]);
+					}
+					
+					size_t kept = 0;
+					for(size_t j = 0; j < active.size(); j++) {
+						glyph_edge* e = active[j];
+						if(scanline > e->yBottom) continue;
+						e->x = e->xTop + (scanline - e->yTop)*e->dxdy;
+						active[kept++] = e;
+					}
+					active.resize(kept);
+					
+					for(size_t j = 1; j < active.size(); j++) {
+						glyph_edge* e = active[j];
+						size_t k = j;
+						for(; k > 0 && active[k-1]->x > e->x; k--) active[k] = active[k-1];
+						active[k] = e;
+					}
+
+					for(size_t m = 0; m + 1 < active.size(); m += 2) {
+						f32 start_intersection = active[m]->x;
+						f32 end_intersection = active[m+1]->x;
+						if(start_intersection < 0) start_intersection = 0;
+						
+						i32 start_index = start_intersection;
+						f32 start_covered = (start_index + 1) - start_intersection;
+						i32 end_index = end_intersection;
+						f32 end_covered = end_intersection - end_index;
+						
+						// crossings exactly on the right border would land one past the row
+						if(end_index >= bitmap_width) { end_index = bitmap_width - 1; end_covered = 1; }
+						if(start_index > end_index) continue;
+
+						if(start_index == end_index) {
+							row[start_index] += alpha_weight*(end_intersection - start_intersection);
+							continue;
+						}
+						
+						row[start_index] += alpha_weight*start_covered;
+						row[end_index] += alpha_weight*end_covered;
+						for(i32 j = start_index+1; j < end_index; j++) {
+							row[j] += alpha_weight;
+						}
+					}
+				}
+			}
+		}
+		
+		// adds one line of a closed outline to the accumulation buffer (font-rs style): every
+		// row the line passes gets the exact signed area it covers to the right of the line
+		// in the pixels it touches, so that a running sum along the row gives the coverage
+		void accumulate_line(f32* acc, i32 acc_width, i32 height, Floint2D p0, Floint2D p1) {
+			if(p0.y == p1.y) return;
+			f32 dir = 1;
+			if(p0.y > p1.y) {
+				dir = -1;
+				std::swap(p0, p1);
+			}
+			
+			if(p1.y <= 0) return;
+			
+			// everything below is clamped to >= 0, so truncation is floor and these
+			// stay plain conversions instead of floorf/ceilf calls on SSE2
+			auto ceilPositive = [](f32 v) -> i32 {i32 i = (i32)v; return i + ((f32)i < v);};
+			
+			f32 dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+			f32 x = p0.x;
+			if(p0.y < 0) x -= p0.y*dxdy;
+			
+			i32 yStart = p0.y <= 0 ? 0 : (i32)p0.y;
+			i32 yEnd = std::min(height, ceilPositive(p1.y));
+			const f32 maxX = (f32)(acc_width - 2);
+			
+			for(i32 y = yStart; y < yEnd; y++) {
+				f32* row = acc + y*acc_width;
+				f32 dy = std::min((f32)(y + 1), p1.y) - std::max((f32)y, p0.y);
+				f32 xnext = x + dxdy*dy;
+				f32 d = dy*dir;
+				
+				f32 x0 = std::min(std::max(std::min(x, xnext), 0.0f), maxX);
+				f32 x1 = std::min(std::max(std::max(x, xnext), 0.0f), maxX);
+				i32 x0i = (i32)x0;
+				f32 x0floor = (f32)x0i;
+				i32 x1i = ceilPositive(x1);
+				f32 x1ceil = (f32)x1i;
+				
+				if(x1i <= x0i + 1) {
+					// the line stays inside of one pixel on this row
+					f32 xmf = 0.5f*(x0 + x1) - x0floor;
+					row[x0i] += d - d*xmf;
+					row[x0i + 1] += d*xmf;
+				} else {
+					f32 s = 1.0f/(x1 - x0);
+					f32 x0f = x0 - x0floor;
+					f32 a0 = 0.5f*s*(1.0f - x0f)*(1.0f - x0f);
+					f32 x1f = x1 - x1ceil + 1.0f;
+					f32 am = 0.5f*s*x1f*x1f;
+					row[x0i] += d*a0;
+					if(x1i == x0i + 2) {
+						row[x0i + 1] += d*(1.0f - a0 - am);
+					} else {
+						f32 a1 = s*(1.5f - x0f);
+						row[x0i + 1] += d*(a1 - a0);
+						for(i32 xi = x0i + 2; xi < x1i - 1; xi++) row[xi] += d*s;
+						f32 a2 = a1 + (x1i - x0i - 3)*s;
+						row[x1i - 1] += d*(1.0f - a2 - am);
+					}
+					row[x1i] += d*am;
+				}
+				x = xnext;
+			}
+		}
+		
+		// running sum along each row of the accumulation buffer turned into 8-bit coverage,
+		// the SIMD version does the prefix sum inside of a register with two shifted adds
+		void accumulate_coverage(const f32* acc, i32 acc_width, u8* bitmap, i32 bitmap_height, i32 bitmap_width, i32 bitmap_stride) {
+			for(i32 y = 0; y < bitmap_height; y++) {
+				const f32* src = acc + y*acc_width;
+				u8* dst = bitmap + y*bitmap_stride;
+				f32 sum = 0;
+				i32 x = 0;
+			#if defined(MPWS_SSE2)
+				__m128 offset = _mm_setzero_ps();
+				const __m128 signMask = _mm_set1_ps(-0.0f);
+				const __m128 one = _mm_set1_ps(1.0f);
+				const __m128 full = _mm_set1_ps(255.0f);
+				for(; x + 4 <= bitmap_width; x += 4) {
+					__m128 v = _mm_loadu_ps(src + x);
+					v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+					v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+					v = _mm_add_ps(v, offset);
+					offset = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+					
+					__m128 cov = _mm_min_ps(_mm_andnot_ps(signMask, v), one);
+					__m128i px = _mm_cvtps_epi32(_mm_mul_ps(cov, full));
+					px = _mm_packs_epi32(px, px);
+					px = _mm_packus_epi16(px, px);
+					i32 packed = _mm_cvtsi128_si32(px);
+					memcpy(dst + x, &packed, 4);
+				}
+				sum = _mm_cvtss_f32(offset);
+			#elif defined(MPWS_NEON)
+				float32x4_t offset = vdupq_n_f32(0);
+				const float32x4_t zero = vdupq_n_f32(0);
+				for(; x + 4 <= bitmap_width; x += 4) {
+					float32x4_t v = vld1q_f32(src + x);
+					v = vaddq_f32(v, vextq_f32(zero, v, 3));
+					v = vaddq_f32(v, vextq_f32(zero, v, 2));
+					v = vaddq_f32(v, offset);
+					offset = vdupq_laneq_f32(v, 3);
+					
+					float32x4_t cov = vminq_f32(vabsq_f32(v), vdupq_n_f32(1.0f));
+					uint32x4_t px = vcvtnq_u32_f32(vmulq_n_f32(cov, 255.0f));
+					uint16x4_t px16 = vmovn_u32(px);
+					uint8x8_t px8 = vmovn_u16(vcombine_u16(px16, px16));
+					vst1_lane_u32((uint32_t*)(dst + x), vreinterpret_u32_u8(px8), 0);
+				}
+				sum = vgetq_lane_f32(offset, 0);
+			#endif
+				for(; x < bitmap_width; x++) {
+					sum += src[x];
+					f32 cov = std::min(fabsf(sum), 1.0f);
+					dst[x] = (u8)lrintf(cov*255.0f);
+				}
+			}
+		}
+		
+		// exact area coverage rasterizer: no sub scanlines and no sorting, every contour
+		// line is accumulated once and a single prefix sum pass produces the coverage
+		void rasterize_glyph_area(const Floint2D* points, const i32* contour_ends, i32 contour_count,
+								  u8* bitmap, i32 bitmap_height, i32 bitmap_width, i32 bitmap_stride, raster_scratch& scratch) {
+			// 2 columns of padding so lines on the right border never wrap into the next row
+			const i32 acc_width = bitmap_width + 2;
+			std::vector<f32>& acc = scratch.accumulation;
+			acc.assign((size_t)acc_width * bitmap_height, 0.0f);
+			
+			i32 j = 0;
+			for(i32 i = 0; i < contour_count; i++) {
+				for(; j < contour_ends[i]-1; j++) {
+					accumulate_line(acc.data(), acc_width, bitmap_height, points[j], points[j+1]);
+				}
+				j++;
+			}
+			
+			accumulate_coverage(acc.data(), acc_width, bitmap, bitmap_height, bitmap_width, bitmap_stride);
+		}
+		
+		// distance to the nearest outline segment for every pixel center within spread of it,
+		// the sign comes from the area rasterizer's coverage of the same outline
+		void build_glyph_sdf(const Floint2D* points, const i32* contour_ends, i32 contour_count,
+							 glyph_sdf& sdf, f32 spread, raster_scratch& scratch, MemoryArena& arena) {
+			ArenaScope scope(arena);
+			const i32 w = sdf.width, h = sdf.height;
+			const size_t count = (size_t)w * h;
+			u8* inside = arena.push<u8>(count);
+			rasterize_glyph_area(points, contour_ends, contour_count, inside, h, w, w, scratch);
+			
+			f32* dist2 = arena.push<f32>(count);
+			std::fill(dist2, dist2 + count, spread * spread);
+			i32 j = 0;
+			for(i32 i = 0; i < contour_count; i++) {
+				for(; j < contour_ends[i]-1; j++) {
+					Floint2D a = points[j], b = points[j+1];
+					f32 dx = b.x - a.x, dy = b.y - a.y;
+					f32 len2 = dx*dx + dy*dy;
+					f32 inv = len2 > 0 ? 1.0f / len2 : 0.0f;
+					
+					i32 x0 = std::max(0, (i32)(std::min(a.x, b.x) - spread));
+					i32 x1 = std::min(w - 1, (i32)(std::max(a.x, b.x) + spread));
+					i32 y0 = std::max(0, (i32)(std::min(a.y, b.y) - spread));
+					i32 y1 = std::min(h - 1, (i32)(std::max(a.y, b.y) + spread));
+					for(i32 y = y0; y <= y1; y++) {
+						f32* row = dist2 + (size_t)y * w;
+						f32 py = y + 0.5f - a.y;
+						for(i32 x = x0; x <= x1; x++) {
+							f32 px = x + 0.5f - a.x;
+							f32 t = std::min(std::max((px*dx + py*dy) * inv, 0.0f), 1.0f);
+							f32 ex = px - t*dx, ey = py - t*dy;
+							row[x] = std::min(row[x], ex*ex + ey*ey);
+						}
+					}
+				}
+				j++;
+			}
+			
+			sdf.field.resize((size_t)w * h);
+			const f32 step = 127.0f / spread;
+			for(size_t i = 0; i < count; i++) {
+				f32 d = sqrtf(dist2[i]);
+				f32 v = 128.0f + (inside[i] >= 128 ? d : -d) * step;
+				sdf.field[i] = (u8)std::min(std::max(v, 0.0f), 255.0f);
+			}
+		}
+		
+		// smoothstep from edge0 over 1/inv field units to 8-bit coverage
+		void sdf_coverage(const f32* values, u8* dst, i32 count, f32 edge0, f32 inv) {
+			i32 x = 0;
+		#if defined(MPWS_SSE2)
+			const __m128 e0 = _mm_set1_ps(edge0);
+			const __m128 scale = _mm_set1_ps(inv);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 three = _mm_set1_ps(3.0f);
+			const __m128 full = _mm_set1_ps(255.0f);
+			for(; x + 4 <= count; x += 4) {
+				__m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + x), e0), scale);
+				t = _mm_min_ps(_mm_max_ps(t, zero), one);
+				__m128 c = _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(three, _mm_add_ps(t, t)));
+				__m128i px = _mm_cvtps_epi32(_mm_mul_ps(c, full));
+				px = _mm_packs_epi32(px, px);
+				px = _mm_packus_epi16(px, px);
+				i32 packed = _mm_cvtsi128_si32(px);
+				memcpy(dst + x, &packed, 4);
+			}
+		#elif defined(MPWS_NEON)
+			const float32x4_t e0 = vdupq_n_f32(edge0);
+			const float32x4_t zero = vdupq_n_f32(0);
+			const float32x4_t one = vdupq_n_f32(1.0f);
+			const float32x4_t three = vdupq_n_f32(3.0f);
+			for(; x + 4 <= count; x += 4) {
+				float32x4_t t = vmulq_n_f32(vsubq_f32(vld1q_f32(values + x), e0), inv);
+				t = vminq_f32(vmaxq_f32(t, zero), one);
+				float32x4_t c = vmulq_f32(vmulq_f32(t, t), vsubq_f32(three, vaddq_f32(t, t)));
+				uint32x4_t px = vcvtnq_u32_f32(vmulq_n_f32(c, 255.0f));
+				uint16x4_t px16 = vmovn_u32(px);
+				uint8x8_t px8 = vmovn_u16(vcombine_u16(px16, px16));
+				vst1_lane_u32((uint32_t*)(dst + x), vreinterpret_u32_u8(px8), 0);
+			}
+		#endif
+			for(; x < count; x++) {
+				f32 t = std::min(std::max((values[x] - edge0) * inv, 0.0f), 1.0f);
+				dst[x] = (u8)lrintf(t*t*(3.0f - 2.0f*t) * 255.0f);
+			}
+		}
+		
+		// resamples a distance field to fontSize pixels per em into the box left/bottom/width/height,
+		// bilinear in the field and a smoothstep one output pixel wide around the outline. the
+		// column taps are the same for every row so they get computed once, each row then lerps
+		// the two field rows it falls between and gathers from that
+		void sample_glyph_sdf(const glyph_sdf& sdf, f32 scale, f32 spread, i32 left, i32 bottom,
+							  u8* coverage, i32 width, i32 height, i32 stride, raster_scratch& scratch) {
+			const f32 toField = 1.0f / scale;
+			const f32 halfBand = 127.0f * toField / (2.0f * spread); // half an output pixel in field units
+			
+			std::vector<i32>& columns = scratch.sample_columns;
+			std::vector<f32>& weights = scratch.sample_weights;
+			columns.resize(width);
+			weights.resize(width);
+			for(i32 x = 0; x < width; x++) {
+				f32 u = (left + x + 0.5f) * toField - sdf.left - 0.5f;
+				u = std::min(std::max(u, 0.0f), (f32)(sdf.width - 1));
+				columns[x] = (i32)u;
+				weights[x] = u - columns[x];
+			}
+			
+			// one extra column so the right tap of the last column stays in bounds
+			std::vector<f32>& buffer = scratch.accumulation;
+			buffer.resize(sdf.width + 1 + width);
+			f32* field = buffer.data();
+			f32* row = field + sdf.width + 1;
+			
+			for(i32 y = 0; y < height; y++) {
+				f32 v = (bottom + y + 0.5f) * toField - sdf.bottom - 0.5f;
+				v = std::min(std::max(v, 0.0f), (f32)(sdf.height - 1));
+				i32 v0 = (i32)v;
+				i32 v1 = std::min(v0 + 1, sdf.height - 1);
+				f32 fv = v - v0;
+				const u8* r0 = sdf.field.data() + (size_t)v0 * sdf.width;
+				const u8* r1 = sdf.field.data() + (size_t)v1 * sdf.width;
+				
+				for(i32 x = 0; x < sdf.width; x++) field[x] = r0[x] + (r1[x] - r0[x]) * fv;
+				field[sdf.width] = field[sdf.width - 1];
+				
+				for(i32 x = 0; x < width; x++) {
+					const f32* tap = field + columns[x];
+					row[x] = tap[0] + (tap[1] - tap[0]) * weights[x];
+				}
+				sdf_coverage(row, coverage + (size_t)y * stride, width, 128.0f - halfBand, 1.0f / (2.0f * halfBand));
+			}
+		}
+		
+		bool loadFont(const i8* path) {return loadFont(path, nullptr);}
+		
+		// with cachePath naming a file writeFontCache made for this very font, the codepoint
+		// table, outlines and bitmaps come straight out of the mapped cache instead of being
+		// built, anything it does not cover still comes from the font. stale or broken
+		// caches are ignored. not synchronized, nothing may draw with the face meanwhile
+		bool loadFont(const i8* path, const i8* cachePath) {
+			// outlines and views of the previous font point into its files
+			clearOutlines();
+			fontCache_.close();
+			
+			if (!fontFile_.open(path)) return false;
+			BEView file = fontFile_.view();
+			BECursor mem_ptr(file);
+			
+			fontDir_ = {};
+			read_font_directory(file, mem_ptr, &fontDir_);
+			parseTables();
+			
+			if(cachePath && fontCache_.open(cachePath, font_checksum(file)))
+				cmap_.attach(fontCache_.cmapIndex(), fontCache_.cmapPages(), fontDir_.f12);
+			else
+				cmap_.build(fontDir_.f4, fontDir_.f12);
+			
+			f32 pixelSize = 64;
+			// Compute scale and baseline shift
+			unitsPerEm_ = head_.unitsPerEm;
+			scale_ = pixelSize / static_cast<float>(unitsPerEm_);
+			baselinePx_ = os2_.sTypoAscender * scale_;
+			
+			// outlines, bitmaps and layouts of a previous font are no longer valid
+			clearOutlines();
+			outlineArena_.reset();
+			glyphSdfs_.clear();
+			clearBitmaps();
+			shapedRuns_.clear();
+			return true;
+		}
+		
+		// loads on a worker thread which also decodes the printable ascii outlines, the face
+		// only gets handed out once it is done. with settings given the new face starts out
+		// configured like it
+		static std::shared_future<std::shared_ptr<FontFace>> loadAsync(const i8* path, const i8* cachePath = nullptr,
+																	   const FontFace* settings = nullptr) {
+			std::shared_ptr<FontFace> face = std::make_shared<FontFace>();
+			if(settings) face->configureLike(*settings);
+			std::string font(path), cache(cachePath ? cachePath : "");
+			// a detached thread and not std::async, whose future would block in its destructor
+			// and make dropping a load that is still running wait for it
+			std::shared_ptr<std::promise<std::shared_ptr<FontFace>>> promise = std::make_shared<std::promise<std::shared_ptr<FontFace>>>();
+			std::shared_future<std::shared_ptr<FontFace>> result = promise->get_future().share();
+			std::thread([promise, face, font, cache]() {
+				try {
+					if(face->loadFont(font.c_str(), cache.empty() ? nullptr : cache.c_str())) face->preloadGlyphs(32, 126);
+					promise->set_value(face);
+				} catch(...) {
+					promise->set_exception(std::current_exception());
+				}
+			}).detach();
+			return result;
+		}
+		
+		// copies the rasterizer settings and cache budget of other
+		void configureLike(const FontFace& other) {
+			setGlyphRasterizer(other.glyphRasterizer_);
+			setSubpixelText(other.subpixelText_);
+			setFlattenTolerance(other.flattenTolerance_);
+			setSdfResolution(other.sdfSize_, other.sdfSpread_);
+			linearText_ = other.linearText_;
+			textGamma_ = other.textGamma_;
+			
+			if(other.glyphCacheBudget() != glyphCacheBudget()) setGlyphCacheBudget(other.glyphCacheBudget());
+		}
+		
+		size_t glyphCacheBudget() const {
+			size_t budget = 0;
+			for(const bitmap_shard& shard : bitmapShards_) budget += shard.bitmaps.budget();
+			return budget;
+		}
+		
+		// decodes the outline on first use, codepoints the font does not map use glyph 0 (.notdef).
+		// decoding happens outside the shard lock, when two threads race for the same codepoint
+		// both decode and the first insert wins
+		glyph_outline* getGlyph(u32 codepoint) {
+			outline_shard& shard = outlineShard(codepoint);
+			{
+				std::lock_guard<std::mutex> lock(shard.lock);
+				glyph_outline* outline = shard.outlines.find(codepoint);
+				if(outline) return outline;
+			}
+			if(!fontFile_.isOpen()) return nullptr;
+			
+			glyph_outline* outline;
+			{
+				std::lock_guard<std::mutex> lock(outlineArenaLock_);
+				outline = outlineArena_.push<glyph_outline>(1);
+				// points flattened with another tolerance are no use, the glyph comes from the font then
+				const font_cache_glyph* cached = fontCache_.isOpen() &&
+					fontCache_.header()->flattenTolerance == flattenTolerance_ ? fontCache_.glyph(codepoint) : nullptr;
+				if(cached) {
+					flat_outline* flat = outlineArena_.push<flat_outline>(1);
+					flat->x = fontCache_.points(cached);
+					flat->y = flat->x + cached->pointCount;
+					flat->ends = fontCache_.ends(cached);
+					flat->count = cached->pointCount;
+					flat->pixelsPerEm = cached->pixelsPerEm;
+					outline->numberOfContours = cached->contours;
+					outline->xMin = cached->xMin;
+					outline->yMin = cached->yMin;
+					outline->xMax = cached->xMax;
+					outline->yMax = cached->yMax;
+					outline->flat = flat;
+				} else {
+					*outline = get_glyph_outline(&fontDir_, get_glyph_index(codepoint), outlineArena_);
+				}
+				outline->glyphIndex = get_glyph_index(codepoint);
+			}
+			
+			std::lock_guard<std::mutex> lock(shard.lock);
+			return shard.outlines.insert(codepoint, outline);
+		}
+		
+		// decodes the inclusive range up front so drawing it later never has to touch the font file
+		void preloadGlyphs(u32 first, u32 last) {
+			for(u32 codepoint = first; codepoint <= last && codepoint >= first; codepoint++) getGlyph(codepoint);
+		}
+		
+		// pos is the pen position on the baseline
+		void drawGlyph(Raster& r, u32 c, Point2D pos, i16 fontSize, Color color) {
+			if(blitCached(r, c, fontSize, pos.x, pos.y, color)) return;
+			glyph_outline* glyph = getGlyph(c);
+			if(glyph == nullptr || glyph->numberOfContours == 0) return;
+			glyph_bitmap* bitmap = rasterizeLetter(c, glyph, fontSize);
+			if(bitmap) blitGlyph(r, bitmap, pos.x, pos.y, color);
+		}
+		
+		// (x, y) is the pen position on the baseline
+		void blitGlyph(Raster& r, const glyph_bitmap* bitmap, i32 x, i32 y, Color color) {
+			r.blendMask(x + bitmap->left, y - bitmap->bottom, bitmap->coverage, bitmap->stride, bitmap->width, bitmap->height,
+						bitmap->channels, true, color, textGamma());
+		}
+		
+		// blits the file or cached bitmap of a codepoint, false when neither has it. cached
+		// glyphs get blitted under the shard lock since other threads may repack the atlas
+		bool blitCached(Raster& r, u32 c, i16 fontSize, i32 x, i32 y, Color color) {
+			glyph_bitmap file;
+			if(fileBitmap(c, fontSize, &file)) {
+				blitGlyph(r, &file, x, y, color);
+				return true;
+			}
+			bitmap_shard& shard = bitmapShard(c, fontSize);
+			std::lock_guard<std::mutex> lock(shard.lock);
+			glyph_bitmap* bitmap = shard.bitmaps.find(c, fontSize);
+			if(bitmap) blitGlyph(r, bitmap, x, y, color);
+			return bitmap != nullptr;
+		}
+		
+		// hands the bitmap of a codepoint to use, rasterizing it when needed. cached bitmaps are
+		// handed out under their shard lock so use must not call back into the face. false for
+		// glyphs without an outline
+		template<typename F> bool useGlyph(u32 c, i16 fontSize, F use) {
+			glyph_bitmap file;
+			if(fileBitmap(c, fontSize, &file)) {
+				use(&file);
+				return true;
+			}
+			{
+				bitmap_shard& shard = bitmapShard(c, fontSize);
+				std::lock_guard<std::mutex> lock(shard.lock);
+				glyph_bitmap* bitmap = shard.bitmaps.find(c, fontSize);
+				if(bitmap) {
+					use(bitmap);
+					return true;
+				}
+			}
+			glyph_outline* glyph = getGlyph(c);
+			if(glyph == nullptr || glyph->numberOfContours == 0) return false;
+			glyph_bitmap* bitmap = rasterizeLetter(c, glyph, fontSize);
+			if(bitmap) use(bitmap);
+			return bitmap != nullptr;
+		}
+		
+		bool hasBitmap(u32 c, i16 fontSize) {
+			glyph_bitmap file;
+			if(fileBitmap(c, fontSize, &file)) return true;
+			bitmap_shard& shard = bitmapShard(c, fontSize);
+			std::lock_guard<std::mutex> lock(shard.lock);
+			return shard.bitmaps.contains(c, fontSize);
+		}
+		
+		// copies a finished bitmap into its shard, glyphs bigger than a shard stay uncached
+		void cacheBitmap(u32 c, i16 fontSize, const glyph_bitmap* src) {
+			bitmap_shard& shard = bitmapShard(c, fontSize);
+			std::lock_guard<std::mutex> lock(shard.lock);
+			glyph_bitmap* bitmap = shard.bitmaps.insert(c, fontSize, src->width, src->height, src->left, src->bottom, src->channels);
+			if(!bitmap) return;
+			const size_t rowBytes = (size_t)src->width * src->channels;
+			for(i32 row = 0; row < src->height; row++)
+				memcpy(bitmap->coverage + (size_t)row * bitmap->stride, src->coverage + (size_t)row * src->stride, rowBytes);
+		}
+		
+		// bitmap out of the font cache file when it was rasterized the way glyphs are rasterized
+		// right now, the file is read only so the view stays valid while the face is loaded
+		bool fileBitmap(u32 c, i16 fontSize, glyph_bitmap* out) {
+			if(!fontCache_.isOpen()) return false;
+			const font_cache_header* h = fontCache_.header();
+			if(h->rasterizer != (u32)glyphRasterizer_ || h->channels != (u32)glyphChannels() ||
+			   h->flattenTolerance != flattenTolerance_) return false;
+			
+			const font_cache_bitmap* b = fontCache_.bitmap(c, fontSize);
+			if(!b) return false;
+			out->width = b->width;
+			out->height = b->height;
+			out->stride = b->width * b->channels;
+			out->left = b->left;
+			out->bottom = b->bottom;
+			out->channels = b->channels;
+			out->coverage = const_cast<u8*>(fontCache_.coverage(b));
+			return true;
+		}
+		
+		// pixel box of a glyph at fontSize pixels per em, left/bottom place it relative
+		// to the pen so every glyph shares the same baseline
+		bool glyphBox(glyph_outline* glyph, i16 fontSize, i32* left, i32* bottom, i32* width, i32* height) {
+			f32 scale = (f32)fontSize/(f32)unitsPerEm_;
+			*left = (i32)floorf(glyph->xMin * scale);
+			*bottom = (i32)floorf(glyph->yMin * scale);
+			*width = (i32)ceilf(glyph->xMax * scale) - *left;
+			*height = (i32)ceilf(glyph->yMax * scale) - *bottom;
+			if(*width <= 0 || *height <= 0) return false;
+			if(glyphChannels() == 3) {
+				// room for the lcd filter to spill into
+				*left -= 1;
+				*width += 2;
+			}
+			return true;
+		}
+		
+		i32 glyphChannels() const {return subpixelText_ && glyphRasterizer_ != MPWS_RASTER_SDF ? 3 : 1;}
+		const text_gamma* textGamma() const {return linearText_ ? &textGamma_ : nullptr;}
+		
+		// distance field of a codepoint at sdfSize_, built on first use
+		const glyph_sdf* glyphSdf(u32 c, glyph_outline* glyph) {
+			std::lock_guard<std::mutex> lock(sdfLock_);
+			auto it = glyphSdfs_.find(c);
+			if(it != glyphSdfs_.end()) return &it->second;
+			
+			glyph_sdf sdf;
+			i32 pad = (i32)ceilf(sdfSpread_) + 1;
+			if(!glyphBox(glyph, sdfSize_, &sdf.left, &sdf.bottom, &sdf.width, &sdf.height)) return nullptr;
+			sdf.left -= pad;
+			sdf.bottom -= pad;
+			sdf.width += 2*pad;
+			sdf.height += 2*pad;
+			
+			f32 scale = (f32)sdfSize_/(f32)unitsPerEm_;
+			thread_scratch& s = scratch();
+			const flat_outline* flat = flatOutline(glyph, sdfSize_, s.raster);
+			s.raster.points.resize(flat->count);
+			scale_points(flat->x, flat->y, flat->count, scale, (f32)-sdf.left, scale, (f32)-sdf.bottom, s.raster.points.data());
+			build_glyph_sdf(s.raster.points.data(), flat->ends, glyph->numberOfContours, sdf, sdfSpread_, s.raster, s.frame);
+			return &glyphSdfs_.emplace(c, std::move(sdf)).first->second;
+		}
+		
+		// the distance fields get built at pixelsPerEm with spread pixels of range on either side
+		// of the outline, larger values keep sharper corners at big sizes and cost more memory
+		void setSdfResolution(i16 pixelsPerEm, f32 spread) {
+			if(pixelsPerEm <= 0 || spread <= 0 || (pixelsPerEm == sdfSize_ && spread == sdfSpread_)) return;
+			sdfSize_ = pixelsPerEm;
+			sdfSpread_ = spread;
+			glyphSdfs_.clear();
+			if(glyphRasterizer_ == MPWS_RASTER_SDF) clearBitmaps();
+		}
+		
+		// flattened contours of a glyph fine enough for pixelsPerEm. outlines get flattened for the
+		// next power of two size from 32 up and kept in the outline arena, so sizes in between only
+		// scale the points. outlines out of a cache file have no curves left, sizes above the
+		// ones the file was made for decode the glyph from the font again
+		const flat_outline* flatOutline(glyph_outline* glyph, f32 pixelsPerEm, raster_scratch& scratch) {
+			glyph_outline source;
+			{
+				std::lock_guard<std::mutex> lock(outlineArenaLock_);
+				const flat_outline* flat = glyph->flat;
+				if(flat && flat->pixelsPerEm >= pixelsPerEm) return flat;
+				source = *glyph;
+				if(source.endPtsOfContours == nullptr) source = get_glyph_outline(&fontDir_, glyph->glyphIndex, outlineArena_);
+			}
+			
+			f32 level = 32;
+			while(level < pixelsPerEm) level *= 2;
+			scratch.contour_ends.resize(source.numberOfContours);
+			generate_points(&source, scratch.points, scratch.contour_ends.data(), level / unitsPerEm_, flattenTolerance_);
+			
+			std::lock_guard<std::mutex> lock(outlineArenaLock_);
+			if(glyph->flat && glyph->flat->pixelsPerEm >= level) return glyph->flat;
+			u32 count = (u32)scratch.points.size();
+			f32* x = outlineArena_.push<f32>((size_t)count * 2);
+			f32* y = x + count;
+			for(u32 i = 0; i < count; i++) {
+				x[i] = scratch.points[i].x;
+				y[i] = scratch.points[i].y;
+			}
+			i32* ends = outlineArena_.push<i32>(source.numberOfContours);
+			memcpy(ends, scratch.contour_ends.data(), sizeof(i32) * source.numberOfContours);
+			
+			flat_outline* flat = outlineArena_.push<flat_outline>(1);
+			flat->x = x;
+			flat->y = y;
+			flat->ends = ends;
+			flat->count = count;
+			flat->pixelsPerEm = level;
+			glyph->flat = flat;
+			return flat;
+		}
+		
+		// out[i] = (x[i]*sx + ox, y[i]*sy + oy), takes flattened outlines to pixels
+		void scale_points(const f32* x, const f32* y, u32 count, f32 sx, f32 ox, f32 sy, f32 oy, Floint2D* out) {
+			u32 i = 0;
+			f32* dst = &out->x;
+		#if defined(MPWS_SSE2)
+			const __m128 scaleX = _mm_set1_ps(sx);
+			const __m128 offsetX = _mm_set1_ps(ox);
+			const __m128 scaleY = _mm_set1_ps(sy);
+			const __m128 offsetY = _mm_set1_ps(oy);
+			for(; i + 4 <= count; i += 4) {
+				__m128 px = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), scaleX), offsetX);
+				__m128 py = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(y + i), scaleY), offsetY);
+				_mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(px, py));
+				_mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(px, py));
+			}
+		#elif defined(MPWS_NEON)
+			const float32x4_t offsetX = vdupq_n_f32(ox);
+			const float32x4_t offsetY = vdupq_n_f32(oy);
+			for(; i + 4 <= count; i += 4) {
+				float32x4x2_t p;
+				p.val[0] = vmlaq_n_f32(offsetX, vld1q_f32(x + i), sx);
+				p.val[1] = vmlaq_n_f32(offsetY, vld1q_f32(y + i), sy);
+				vst2q_f32(dst + 2*i, p);
+			}
+		#endif
+			for(; i < count; i++) {
+				out[i].x = x[i]*sx + ox;
+				out[i].y = y[i]*sy + oy;
+			}
+		}
+		
+		// writes a font cache for the loaded font: the codepoint table, the outlines of every
+		// mapped codepoint in [first, last] flattened for the largest of sizes, and their
+		// bitmaps at every size made with the current rasterizer settings
+		bool writeFontCache(const i8* path, u32 first, u32 last, const i16* sizes, i32 sizeCount) {
+			if(!fontFile_.isOpen()) return false;
+			
+			std::vector<u8> out(sizeof(font_cache_header), 0);
+			auto align = [&out](size_t a) {out.resize((out.size() + a - 1) & ~(a - 1), 0);};
+			auto append = [&out](const void* data, size_t bytes) {
+				size_t at = out.size();
+				out.insert(out.end(), (const u8*)data, (const u8*)data + bytes);
+				return (u32)at;
+			};
+			font_cache_header h;
+			memset(&h, 0, sizeof(h));
+			
+			// codepoint table
+			u16 index[256];
+			std::vector<u16> pages;
+			for(u32 i = 0; i < 256; i++) {
+				const u16* page = cmap_.page(i);
+				index[i] = page ? (u16)(pages.size() / 256) : 0xFFFF;
+				if(page) pages.insert(pages.end(), page, page + 256);
+			}
+			h.cmapIndex = append(index, sizeof(index));
+			h.cmapPages = append(pages.data(), pages.size() * sizeof(u16));
+			h.cmapPageCount = (u32)(pages.size() / 256);
+			
+			// outlines, flattened finely enough for the biggest size
+			i16 flattenSize = 32;
+			for(i32 i = 0; i < sizeCount; i++) flattenSize = std::max(flattenSize, sizes[i]);
+			
+			std::vector<font_cache_glyph> glyphs;
+			std::vector<u32> codepoints;
+			for(u32 c = first; c <= last && c >= first; c++) {
+				if(get_glyph_index(c) == 0) continue;
+				glyph_outline* glyph = getGlyph(c);
+				if(glyph == nullptr) continue;
+				
+				font_cache_glyph g;
+				memset(&g, 0, sizeof(g));
+				g.codepoint = c;
+				g.contours = glyph->numberOfContours;
+				g.xMin = glyph->xMin;
+				g.yMin = glyph->yMin;
+				g.xMax = glyph->xMax;
+				g.yMax = glyph->yMax;
+				if(g.contours > 0) {
+					const flat_outline* flat = flatOutline(glyph, flattenSize, scratch().raster);
+					align(8);
+					g.points = append(flat->x, (size_t)flat->count * 2 * sizeof(f32));
+					g.pointCount = flat->count;
+					g.ends = append(flat->ends, g.contours * sizeof(i32));
+					g.pixelsPerEm = flat->pixelsPerEm;
+					codepoints.push_back(c);
+				}
+				glyphs.push_back(g);
+			}
+			
+			// bitmaps, sorted by (size, codepoint) like their keys
+			std::vector<i16> sorted(sizes, sizes + sizeCount);
+			std::sort(sorted.begin(), sorted.end());
+			sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+			
+			std::vector<font_cache_bitmap> bitmaps;
+			const i32 channels = glyphChannels();
+			for(i16 size : sorted) {
+				if(size <= 0) continue;
+				for(u32 c : codepoints) {
+					glyph_outline* glyph = getGlyph(c);
+					font_cache_bitmap b;
+					memset(&b, 0, sizeof(b));
+					if(!glyphBox(glyph, size, &b.left, &b.bottom, &b.width, &b.height)) continue;
+					if(glyphRasterizer_ == MPWS_RASTER_SDF && glyphSdf(c, glyph) == nullptr) continue;
+					
+					b.key = ((uint64_t)(u32)size << 32) | c;
+					b.channels = channels;
+					size_t bytes = (size_t)b.width * channels * b.height;
+					b.coverage = (u32)out.size();
+					out.resize(out.size() + bytes, 0);
+					rasterizeOutline(c, glyph, size, b.left, b.bottom, out.data() + b.coverage,
+									 b.width, b.height, b.width * channels, scratch().raster);
+					bitmaps.push_back(b);
+				}
+			}
+			
+			align(8);
+			h.glyphs = append(glyphs.data(), glyphs.size() * sizeof(font_cache_glyph));
+			h.glyphCount = (u32)glyphs.size();
+			align(8);
+			h.bitmaps = append(bitmaps.data(), bitmaps.size() * sizeof(font_cache_bitmap));
+			h.bitmapCount = (u32)bitmaps.size();
+			
+			h.magic = FONT_CACHE_MAGIC;
+			h.version = FONT_CACHE_VERSION;
+			h.byteOrder = 0x01020304;
+			h.recordSizes = (u32)(sizeof(font_cache_glyph) << 16 | sizeof(font_cache_bitmap));
+			h.fontKey = font_checksum(fontFile_.view());
+			h.fileSize = (u32)out.size();
+			h.rasterizer = (u32)glyphRasterizer_;
+			h.channels = (u32)channels;
+			h.flattenTolerance = flattenTolerance_;
+			memcpy(out.data(), &h, sizeof(h));
+			
+			// other processes and this face may have the old file mapped, truncating it under
+			// them would fault their reads. a new file renamed over it leaves them the old inode
+			std::string temp = std::string(path) + ".tmp";
+			FILE* file = fopen(temp.c_str(), "wb");
+			if(!file) return false;
+			bool written = fwrite(out.data(), out.size(), 1, file) == 1;
+			written = fclose(file) == 0 && written;
+		#if defined(UTIL_WIN32)
+			written = written && MoveFileExA(temp.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+		#else
+			written = written && rename(temp.c_str(), path) == 0;
+		#endif
+			if(!written) remove(temp.c_str());
+			return written;
+		}
+		
+		// only touches the given scratch and coverage so threads can run it side by side,
+		// in sdf mode the field has to be built already and is looked up under sdfLock_
+		void rasterizeOutline(u32 c, glyph_outline* glyph, i16 fontSize, i32 left, i32 bottom, u8* coverage,
+							  i32 width, i32 height, i32 stride, raster_scratch& scratch) {
+			f32 scale = (f32)fontSize/(f32)unitsPerEm_;
+			
+			if(glyphRasterizer_ == MPWS_RASTER_SDF) {
+				const glyph_sdf* sdf = nullptr;
+				{
+					std::lock_guard<std::mutex> lock(sdfLock_);
+					auto it = glyphSdfs_.find(c);
+					if(it != glyphSdfs_.end()) sdf = &it->second;
+				}
+				if(sdf)
+					sample_glyph_sdf(*sdf, (f32)fontSize/(f32)sdfSize_, sdfSpread_, left, bottom,
+									 coverage, width, height, stride, scratch);
+				return;
+			}
+			
+			// lcd masks get rasterized 3 times as wide and filtered down into coverage
+			const i32 channels = glyphChannels();
+			u8* target = coverage;
+			i32 targetWidth = width * channels;
+			i32 targetStride = stride;
+			if(channels == 3) {
+				scratch.subpixels.assign((size_t)targetWidth * height, 0);
+				target = scratch.subpixels.data();
+				targetStride = targetWidth;
+			}
+			
+			const flat_outline* flat = flatOutline(glyph, fontSize, scratch);
+			std::vector<Floint2D>& temp_points = scratch.points;
+			temp_points.resize(flat->count);
+			scale_points(flat->x, flat->y, flat->count, scale * channels, (f32)(-left * channels), scale, (f32)-bottom, temp_points.data());
+			const i32 *contour_end_pts = flat->ends;
+			
+			if(glyphRasterizer_ == MPWS_RASTER_AREA) {
+				rasterize_glyph_area(temp_points.data(), contour_end_pts, glyph->numberOfContours,
+									 target, height, targetWidth, targetStride, scratch);
+			} else {
+				//lines
+				i32 edge_count = 0;
+				Line2D* edges = generate_edges(temp_points.data(), &edge_count, contour_end_pts, glyph->numberOfContours, scratch);
+				rasterize_glyph(edges, edge_count, target, height, targetWidth, targetStride, scratch);
+			}
+			
+			if(channels == 3) lcd_filter(target, targetWidth, height, coverage, stride);
+		}
+		
+		// spreads every subpixel over its neighbours with weights 1 2 3 2 1 / 9 so the
+		// colour fringes stay faint
+		void lcd_filter(const u8* src, i32 width, i32 height, u8* dst, i32 dst_stride) {
+			for(i32 y = 0; y < height; y++) {
+				const u8* s = src + (size_t)y * width;
+				u8* d = dst + (size_t)y * dst_stride;
+				for(i32 x = 0; x < width; x++) {
+					u32 sum = 3 * s[x];
+					if(x > 0) sum += 2 * s[x-1];
+					if(x > 1) sum += s[x-2];
+					if(x + 1 < width) sum += 2 * s[x+1];
+					if(x + 2 < width) sum += s[x+2];
+					d[x] = (u8)((sum * 7282) >> 16);
+				}
+			}
+		}
+		
+		// rasterizes into the calling thread's letter bitmap and copies that into the cache,
+		// the result is valid until the thread rasterizes its next letter
+		glyph_bitmap* rasterizeLetter(u32 c, glyph_outline* glyph, i16 fontSize) {
+			i32 left, bottom, width, height;
+			if(!glyphBox(glyph, fontSize, &left, &bottom, &width, &height)) return nullptr;
+			if(glyphRasterizer_ == MPWS_RASTER_SDF && glyphSdf(c, glyph) == nullptr) return nullptr;
+			
+			const i32 channels = glyphChannels();
+			thread_scratch& s = scratch();
+			s.letterCoverage.assign((size_t)width * channels * height, 0);
+			glyph_bitmap* bitmap = &s.letter;
+			bitmap->width = width;
+			bitmap->height = height;
+			bitmap->stride = width * channels;
+			bitmap->left = left;
+			bitmap->bottom = bottom;
+			bitmap->channels = channels;
+			bitmap->coverage = s.letterCoverage.data();
+			
+			rasterizeOutline(c, glyph, fontSize, left, bottom, bitmap->coverage, width, height, bitmap->stride, s.raster);
+			cacheBitmap(c, fontSize, bitmap);
+			return bitmap;
+		}
+		
+		// rasterizes every glyph of the list that is not cached yet at fontSize, spread over
+		// all cores when there are enough of them: outlines get decoded and boxes laid out in
+		// a staging buffer up front, the threads pull glyphs off a shared counter and each
+		// rasterizes with its own scratch, then the bitmaps are committed to the cache in order
+		void rasterizeGlyphs(const u32* codepoints, size_t count, i16 fontSize) {
+			typedef struct {
+				u32 codepoint;
+				glyph_outline* glyph;
+				i32 left, bottom, width, height;
+				size_t offset;
+			} job;
+			
+			thread_scratch& s = scratch();
+			ArenaScope scope(s.frame);
+			u32* seen = s.frame.push<u32>(count);
+			memcpy(seen, codepoints, sizeof(u32) * count);
+			std::sort(seen, seen + count);
+			size_t unique = std::unique(seen, seen + count) - seen;
+			
+			job* jobs = s.frame.push<job>(unique);
+			size_t jobCount = 0;
+			size_t staging = 0;
+			const i32 channels = glyphChannels();
+			for(size_t k = 0; k < unique; k++) {
+				u32 c = seen[k];
+				if(hasBitmap(c, fontSize)) continue;
+				job j;
+				j.codepoint = c;
+				j.glyph = getGlyph(c);
+				if(j.glyph == nullptr || j.glyph->numberOfContours == 0) continue;
+				if(!glyphBox(j.glyph, fontSize, &j.left, &j.bottom, &j.width, &j.height)) continue;
+				// fields and flat outlines are built up front so the threads only ever read them
+				if(glyphRasterizer_ == MPWS_RASTER_SDF && glyphSdf(c, j.glyph) == nullptr) continue;
+				if(glyphRasterizer_ != MPWS_RASTER_SDF) flatOutline(j.glyph, fontSize, s.raster);
+				j.offset = staging;
+				staging += (size_t)j.width * channels * j.height;
+				jobs[jobCount++] = j;
+			}
+			if(jobCount == 0) return;
+			
+			u8* coverage = s.frame.push<u8>(staging);
+			const size_t minJobsPerThread = 4;
+			i32 numThreads = (i32)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+												   (jobCount + minJobsPerThread - 1) / minJobsPerThread);
+			
+			if(numThreads <= 1) {
+				for(size_t i = 0; i < jobCount; i++) {
+					const job& j = jobs[i];
+					rasterizeOutline(j.codepoint, j.glyph, fontSize, j.left, j.bottom, coverage + j.offset, j.width, j.height, j.width * channels, s.raster);
+				}
+			} else {
+				if((i32)s.workers.size() < numThreads) s.workers.resize(numThreads);
+				std::atomic<size_t> next(0);
+				std::vector<std::thread> threads;
+				for(i32 t = 0; t < numThreads; ++t) {
+					raster_scratch* worker = &s.workers[t];
+					threads.emplace_back([&, worker]() {
+						for(size_t i = next++; i < jobCount; i = next++) {
+							const job& j = jobs[i];
+							this->rasterizeOutline(j.codepoint, j.glyph, fontSize, j.left, j.bottom, coverage + j.offset, j.width, j.height, j.width * channels, *worker);
+						}
+					});
+				}
+				for(auto& thread : threads) thread.join();
+			}
+			
+			for(size_t i = 0; i < jobCount; i++) {
+				const job& j = jobs[i];
+				glyph_bitmap bitmap;
+				bitmap.width = j.width;
+				bitmap.height = j.height;
+				bitmap.stride = j.width * channels;
+				bitmap.left = j.left;
+				bitmap.bottom = j.bottom;
+				bitmap.channels = channels;
+				bitmap.coverage = coverage + j.offset;
+				cacheBitmap(j.codepoint, fontSize, &bitmap);
+			}
+		}
+		
+		// rasterizes the missing glyphs of run from glyph first on
+		void rasterizeRun(const shaped_run* run, size_t first, i16 size) {
+			MemoryArena& frame = scratch().frame;
+			ArenaScope scope(frame);
+			size_t count = run->glyphs.size() - first;
+			u32* codepoints = frame.push<u32>(count);
+			for(size_t i = 0; i < count; i++) codepoints[i] = run->glyphs[first + i].codepoint;
+			rasterizeGlyphs(codepoints, count, size);
+		}
+		
+		// warms the cache for a block of text before it gets drawn
+		void prepareText(const i8* utf8, i16 size) {
+			std::shared_ptr<const shaped_run> run = shapeText(utf8, size);
+			if(!run->glyphs.empty()) rasterizeRun(run.get(), 0, size);
+		}
+		
+		// lays out a utf-8 string once per (text, size), advances come from hmtx and
+		// the kern table, '\n' starts a new line one hhea line height further down.
+		// the run stays valid for as long as the caller holds on to it
+		std::shared_ptr<const shaped_run> shapeText(const i8* utf8, i16 size) {
+			size_t length = strlen(utf8);
+			{
+				std::lock_guard<std::mutex> lock(runLock_);
+				std::shared_ptr<shaped_run> cached = shapedRuns_.find(utf8, length, size);
+				if(cached) return cached;
+			}
+			
+			std::shared_ptr<shaped_run> run = std::make_shared<shaped_run>();
+			run->text.assign(utf8, length);
+			run->size = size;
+			run->width = 0;
+			run->height = 0;
+			if(!fontFile_.isOpen() || unitsPerEm_ == 0) return run;
+			
+			f32 scale = (f32)size / (f32)unitsPerEm_;
+			f32 lineHeight = (hhea_.ascender - hhea_.descender + hhea_.lineGap) * scale;
+			f32 penX = 0, penY = 0;
+			u32 previous = 0xFFFFFFFF;
+			
+			const i8* text = utf8;
+			const i8* end = utf8 + length;
+			while(text < end) {
+				u32 c = utf8_next(&text);
+				if(c == '\n') {
+					run->width = std::max(run->width, (i32)ceilf(penX));
+					penX = 0;
+					penY += lineHeight;
+					previous = 0xFFFFFFFF;
+					continue;
+				}
+				
+				u32 glyph_index = get_glyph_index(c);
+				if(previous != 0xFFFFFFFF) penX += get_kerning(previous, glyph_index) * scale;
+				
+				glyph_outline* glyph = getGlyph(c);
+				if(glyph && glyph->numberOfContours > 0) {
+					shaped_glyph g = {c, (i32)lrintf(penX), (i32)lrintf(penY)};
+					run->glyphs.push_back(g);
+				}
+				
+				penX += get_advance(glyph_index) * scale;
+				previous = glyph_index;
+			}
+			run->width = std::max(run->width, (i32)ceilf(penX));
+			run->height = (i32)lrintf(penY);
+			
+			std::lock_guard<std::mutex> lock(runLock_);
+			shapedRuns_.insert(run);
+			return run;
+		}
+		
+		// width of the widest line in pixels
+		i32 measureText(const i8* utf8, i16 size) {return shapeText(utf8, size)->width;}
+		
+		// pos is the pen position on the baseline of the first line, the first glyph that
+		// misses the cache rasterizes all missing glyphs of the rest of the run at once
+		void drawText(Raster& r, const i8* utf8, Point2D pos, i16 size, Color color) {
+			std::shared_ptr<const shaped_run> run = shapeText(utf8, size);
+			bool batched = false;
+			for(size_t k = 0; k < run->glyphs.size(); k++) {
+				const shaped_glyph& g = run->glyphs[k];
+				Point2D pen(pos.x + g.x, pos.y + g.y);
+				if(blitCached(r, g.codepoint, size, pen.x, pen.y, color)) continue;
+				if(!batched) {
+					rasterizeRun(run.get(), k, size);
+					batched = true;
+					if(blitCached(r, g.codepoint, size, pen.x, pen.y, color)) continue;
+				}
+				// evicted by another thread or too big for the cache
+				drawGlyph(r, g.codepoint, pen, size, color);
+			}
+		}
+		
+		void setFlattenTolerance(f32 pixels) {
+			if(pixels <= 0 || pixels == flattenTolerance_) return;
+			flattenTolerance_ = pixels;
+			// the flat outlines hang off the outlines, both get decoded again
+			clearOutlines();
+			outlineArena_.reset();
+			glyphSdfs_.clear();
+			clearBitmaps();
+		}
+		
+		// switching rasterizers invalidates every cached bitmap, MPWS_RASTER_SDF builds one distance
+		// field per glyph and resamples it for every size so new sizes never touch the outline
+		void setGlyphRasterizer(GLYPH_RASTERIZER rasterizer) {
+			if(rasterizer == glyphRasterizer_) return;
+			glyphRasterizer_ = rasterizer;
+			clearBitmaps();
+		}
+		
+		// lcd subpixel masks for screens with horizontal rgb stripes, triple the cache space
+		void setSubpixelText(bool enabled) {
+			if(enabled == subpixelText_) return;
+			subpixelText_ = enabled;
+			clearBitmaps();
+		}
+		
+		// blends text in linear light for gamma > 1 (2.2 matches sRGB closely), 1 or less blends
+		// the stored values directly which is faster but makes light text on dark look thin
+		void setTextGamma(f32 gamma) {
+			linearText_ = gamma > 1.0f;
+			if(linearText_) build_text_gamma(&textGamma_, gamma);
+		}
+		
+	};
+	
+	// text that keeps its layout and one coverage mask of all its glyphs between frames, so
+	// drawing it costs a single mask blit. the mask only gets built again when the text, the
+	// size or the face changes, the color is applied while blitting
+	class TextLabel {
+	private:
+		std::shared_ptr<FontFace> face_;
+		std::string text_;
+		i16 size_;
+		Color color_;
+		
+		std::vector<u8> coverage_; // top down rows of width_*channels_ bytes
+		std::vector<i32> spans_;   // first and last+1 covered pixel of every row
+		i32 left_ = 0, top_ = 0;   // of the mask relative to the pen on the first baseline
+		i32 width_ = 0, height_ = 0;
+		i32 channels_ = 1;
+		i32 advance_ = 0;
+		bool dirty_ = true;
+		u32 generation_ = 0;
+		
+		void build() {
+			dirty_ = false;
+			generation_ = face_ ? face_->generation() : 0;
+			width_ = height_ = advance_ = 0;
+			if(!face_ || !face_->isLoaded()) return;
+			
+			std::shared_ptr<const shaped_run> run = face_->shapeText(text_.c_str(), size_);
+			advance_ = run->width;
+			if(run->glyphs.empty()) return;
+			face_->rasterizeRun(run.get(), 0, size_);
+			
+			// glyph boxes are pen relative and bottom up, the mask is top down
+			i32 x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+			for(const shaped_glyph& g : run->glyphs) {
+				i32 left, bottom, width, height;
+				glyph_outline* glyph = face_->getGlyph(g.codepoint);
+				if(!glyph || !face_->glyphBox(glyph, size_, &left, &bottom, &width, &height)) continue;
+				x0 = std::min(x0, g.x + left);
+				x1 = std::max(x1, g.x + left + width);
+				y0 = std::min(y0, g.y - bottom - height + 1);
+				y1 = std::max(y1, g.y - bottom + 1);
+			}
+			if(x0 >= x1 || y0 >= y1) return;
+			
+			channels_ = face_->glyphChannels();
+			left_ = x0;
+			top_ = y0;
+			width_ = x1 - x0;
+			height_ = y1 - y0;
+			const i32 stride = width_ * channels_;
+			coverage_.assign((size_t)stride * height_, 0);
+			
+			for(const shaped_glyph& g : run->glyphs) {
+				face_->useGlyph(g.codepoint, size_, [&](const glyph_bitmap* b) {
+					// overlapping glyphs combine like two blends on top of each other would
+					i32 x = g.x + b->left - left_;
+					i32 y = g.y - b->bottom - top_;
+					if(b->channels != channels_ || x < 0 || x + b->width > width_) return;
+					for(i32 j = 0; j < b->height; j++) {
+						if(y - j < 0 || y - j >= height_) continue;
+						const u8* src = b->coverage + (size_t)j * b->stride;
+						u8* dst = coverage_.data() + (size_t)(y - j) * stride + (size_t)x * channels_;
+						for(i32 i = 0; i < b->width * channels_; i++)
+							dst[i] = (u8)(dst[i] + src[i] - (dst[i] * src[i] + 127) / 255);
+					}
+				});
+			}
+			
+			// blits skip the empty ends of every row and the rows between lines
+			spans_.assign((size_t)height_ * 2, 0);
+			for(i32 y = 0; y < height_; y++) {
+				const u8* row = coverage_.data() + (size_t)y * stride;
+				i32 first = 0, last = stride;
+				while(first < last && row[first] == 0) first++;
+				while(last > first && row[last - 1] == 0) last--;
+				spans_[y*2] = first / channels_;
+				spans_[y*2 + 1] = (last + channels_ - 1) / channels_;
+			}
+		}
+		
+	public:
+		TextLabel(std::shared_ptr<FontFace> face, const i8* text, i16 size, Color color = Color(0,0,0)):
+			face_(std::move(face)), text_(text), size_(size), color_(color) {}
+		
+		void setText(const i8* text) {
+			if(text_ == text) return;
+			text_ = text;
+			dirty_ = true;
+		}
+		
+		void setSize(i16 size) {
+			if(size == size_) return;
+			size_ = size;
+			dirty_ = true;
+		}
+		
+		void setFont(std::shared_ptr<FontFace> face) {
+			if(face == face_) return;
+			face_ = std::move(face);
+			dirty_ = true;
+		}
+		
+		void setColor(Color color) {color_ = color;}
+		
+		// pos is the pen position on the baseline of the first line
+		void draw(Raster& r, Point2D pos) {
+			if(dirty_ || (face_ && face_->generation() != generation_)) build();
+			if(width_ == 0) return;
+			const i32 stride = width_ * channels_;
+			const text_gamma* gamma = face_->textGamma();
+			// one blend per run of rows that cover the same columns. a single blend of the whole
+			// mask would also go over the blank ends of shorter lines and the gaps between lines
+			for(i32 y = 0, rows; y < height_; y += rows) {
+				i32 first = spans_[y*2], last = spans_[y*2 + 1];
+				for(rows = 1; y + rows < height_ && spans_[(y + rows)*2] == first && spans_[(y + rows)*2 + 1] == last; rows++) {}
+				if(first == last) continue;
+				r.blendMask(pos.x + left_ + first, pos.y + top_ + y, coverage_.data() + (size_t)y * stride + first * channels_,
+							stride, last - first, rows, channels_, false, color_, gamma);
+			}
+		}
+		
+		// width of the widest line in pixels
+		i32 advance() {
+			if(dirty_ || (face_ && face_->generation() != generation_)) build();
+			return advance_;
+		}
+		
+		const std::string& text() const {return text_;}
+		i16 size() const {return size_;}
+	};
+	
+	// bounded single producer single consumer queue between the thread that talks to the os
+	// and the app thread, neither side ever blocks or takes a lock. both indices only grow and
+	// wrap through the mask, every side keeps a copy of the other side's index and only reads
+	// the shared one when the ring looks full or empty. a full ring drops the new value, so
+	// producers that must not lose anything check free() first
+	template<typename T, u32 Capacity> class EventRing {
+	private:
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity has to be a power of 2");
+		
+		alignas(64) std::atomic<u32> head_; // next slot to read, only the consumer writes it
+		u32 cachedTail_ = 0;                // consumer's view of tail_
+		alignas(64) std::atomic<u32> tail_; // next slot to write, only the producer writes it
+		u32 cachedHead_ = 0;                // producer's view of head_
+		std::atomic<u32> dropped_;
+		alignas(64) T slots_[Capacity];
+		
+	public:
+		EventRing(): head_(0), tail_(0), dropped_(0) {}
+		
+		EventRing(const EventRing&) = delete;
+		EventRing& operator=(const EventRing&) = delete;
+		
+		// producer side
+		bool push(const T& value) {
+			u32 tail = tail_.load(std::memory_order_relaxed);
+			if(tail - cachedHead_ == Capacity) {
+				cachedHead_ = head_.load(std::memory_order_acquire);
+				if(tail - cachedHead_ == Capacity) {
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+			}
+			slots_[tail & (Capacity - 1)] = value;
+			tail_.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+		
+		// consumer side, pops up to max values in order and returns how many
+		u32 pop(T* out, u32 max) {
+			u32 head = head_.load(std::memory_order_relaxed);
+			if(cachedTail_ - head < max) cachedTail_ = tail_.load(std::memory_order_acquire);
+			u32 count = std::min(cachedTail_ - head, max);
+			for(u32 i = 0; i < count; i++) out[i] = slots_[(head + i) & (Capacity - 1)];
+			head_.store(head + count, std::memory_order_release);
+			return count;
 		}
 		
-		Line2D* generate_edges(Floint2D *pts_gen, i32 *edge_count, i32 *contour_ends, i32 contour_count) {
-			i32 j = 0;
-			i32 edge_index = 0;
-			Line2D *edges = (Line2D*) malloc(sizeof(Line2D)*contour_ends[contour_count-1]);
-			for(i32 i = 0; i < contour_count; i++) {
-				for(; j < contour_ends[i]-1; j++) {
-					Line2D *edge = edges + edge_index;
-					edge->p0.x = pts_gen[j].x;
-					edge->p0.y = pts_gen[j].y;
-					
-					edge->p1.x = pts_gen[j+1].x;
-					edge->p1.y = pts_gen[j+1].y;
-					edge_index++;
+		bool pop(T* out) {return pop(out, 1) == 1;}
+		
+		// consumer side, copies the oldest value without removing it
+		bool peek(T* out) {
+			u32 head = head_.load(std::memory_order_relaxed);
+			if(cachedTail_ == head) cachedTail_ = tail_.load(std::memory_order_acquire);
+			if(cachedTail_ == head) return false;
+			*out = slots_[head & (Capacity - 1)];
+			return true;
+		}
+		
+		// only exact from the consumer's side
+		u32 size() const {return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_relaxed);}
+		bool empty() const {return size() == 0;}
+		
+		// producer side, never more than push will take
+		u32 free() const {return Capacity - (tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire));}
+		bool full() const {return free() == 0;}
+		u32 capacity() const {return Capacity;}
+		u32 dropped() const {return dropped_.load(std::memory_order_relaxed);}
+	};
+	
+	// paces the app thread to a target frame rate, 0 fps runs unlimited. waiting sleeps in
+	// short steps while the deadline is further away than a sleep tends to overshoot and spins
+	// on the steady clock for the rest, the overshoot is learned from the sleeps themselves.
+	// deadlines advance by whole periods so the rate holds over time, a frame that ran past
+	// its deadline counts as missed and a frame more than a period late restarts the schedule
+	// instead of bursting to catch up
+	class FrameScheduler {
+	public:
+		typedef std::chrono::steady_clock clock;
+		
+	private:
+		clock::duration period_ = clock::duration::zero();
+		clock::time_point frameStart_;
+		clock::time_point deadline_;
+		u32 frames_ = 0;
+		u32 missed_ = 0;
+		f32 frameTime_ = 0.0f; // seconds, start to start
+		f32 workTime_ = 0.0f;  // seconds, start to the next waitFrame
+		
+		// what a 1ms sleep really takes, mean and variance smoothed over recent sleeps
+		f64 sleepMean_ = 0.002;
+		f64 sleepVar_ = 0.0;
+		
+		bool adaptive_ = false;
+		f32 quality_ = 1.0f;
+		f32 minQuality_ = 0.5f;
+		f32 load_ = 0.0f;      // smoothed work time over the period
+		
+	#if defined(UTIL_WIN32)
+		// sleep_for rounds up to the 15.6ms system tick, which left most of a 60fps frame to
+		// the spin. a high resolution timer (windows 10 1803 on) wakes within the millisecond,
+		// without one the sleeps stay coarse
+		HANDLE timer_ = NULL;
+	#endif
+		
+		static f64 seconds(clock::duration d) {return std::chrono::duration<f64>(d).count();}
+		
+		void sleepBriefly() {
+		#if defined(UTIL_WIN32)
+			if(timer_) {
+				LARGE_INTEGER due;
+				due.QuadPart = -10000; // relative, in 100ns
+				if(SetWaitableTimer(timer_, &due, 0, NULL, NULL, FALSE)) {
+					WaitForSingleObject(timer_, INFINITE);
+					return;
 				}
-				j++; //we are the end of the contour, skip over this point to the start of the next contour
 			}
-			
-			*edge_count = edge_index;
-
-			return edges;
+		#endif
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
-
-		void rasterize_glyph(Line2D *edges, i32 edge_count, u8 *bitmap, i32 bitmap_height, i32 bitmap_width) {
-			f32 intersections[32] = {0};
-			i32 intersection_count = 0;
-			i32 scanline_subdiv = 5;
-			f32 alpha_weight = 255.0/scanline_subdiv;
-			f32 step_per_scanline = 1.0/5;
-
-			for(i32 i = 0; i < bitmap_height; i++) {
-
-				for(i32 x = 0; x < scanline_subdiv; x++) {
-					intersection_count = 0;
-
-					f32 scanline = i + x*step_per_scanline;
-
-					for(i32 j = 0; j < edge_count; j++) {
-						Line2D *edge = edges + j;
-						
-						f32 bigger_y =  edge->p0.y;
-						f32 smaller_y = edge->p1.y;
-						
-						
-						if(edge->p0.y < edge->p1.y) {
-							bigger_y =  edge->p1.y;
-							smaller_y = edge->p0.y;
-						}
-
-						if(scanline <= smaller_y) continue;
-						if(scanline > bigger_y) continue;
-
-						f32 dx = edge->p1.x - edge->p0.x;
-						f32 dy = edge->p1.y - edge->p0.y;
-
-						if(dy == 0) continue;
-
-
-						f32 intersection = -1;
-						if(dx == 0) {
-							intersection = edge->p0.x;
-						} else {
-							intersection = (scanline - edge->p0.y)*(dx/dy) + edge->p0.x;
-							if(intersection < 0) intersection = edge->p0.x;
-						}
-
-						intersections[intersection_count] = intersection;
-						intersection_count++;
-					}
-					
-					qsort(intersections, intersection_count, sizeof(f32), cmp_floats);
-
-
-					if(intersection_count > 1) {
-						for(i32 m = 0; m < intersection_count; m += 2) {
-							f32 start_intersection = intersections[m];
-							i32 start_index = intersections[m];
-							f32 start_covered = (start_index + 1) - start_intersection ;
-
-							f32 end_intersection = intersections[m+1];
-							i32 end_index = intersections[m+1];
-							f32 end_covered = end_intersection - (end_index);
-
-							if(start_index == end_index) {
-								bitmap[start_index + i*bitmap_width] += alpha_weight*start_covered;
-							} else {
-								bitmap[start_index + i*bitmap_width] += alpha_weight*start_covered;
-								bitmap[end_index + i*bitmap_width] += alpha_weight*end_covered;
-							}
-
-							for(i32 j = start_index+1; j < end_index; j++) {
-								bitmap[j + i*bitmap_width] += alpha_weight;
-							}
-						}
-					}
-				}
+		
+		void preciseWait(clock::time_point deadline) {
+			for(;;) {
+				clock::time_point before = clock::now();
+				if(seconds(deadline - before) <= sleepMean_ + 2.0 * std::sqrt(sleepVar_)) break;
+				sleepBriefly();
+				f64 took = seconds(clock::now() - before);
+				f64 delta = took - sleepMean_;
+				sleepMean_ += 0.1 * delta;
+				sleepVar_ = 0.9 * (sleepVar_ + 0.1 * delta * delta);
 			}
+			while(clock::now() < deadline) std::this_thread::yield();
 		}
 		
-		void loadFont(const i8* path) {
-			i32 file_size = 0;
-			i8* file = read_file(path, &file_size);
-			if (file == NULL) return;
-			i8* mem_ptr = file;
-			
-			fontDir_ = {0};
-			read_font_directory(file, &mem_ptr, &fontDir_);
-			parseTables();
-			
-			f32 pixelSize = 64;
-			// Compute scale and baseline shift
-			unitsPerEm_ = head_->unitsPerEm;
-			scale_ = pixelSize / static_cast<float>(unitsPerEm_);
-			baselinePx_ = os2_->sTypoAscender * scale_;
+		void adapt() {
+			load_ += 0.2f * (workTime_ / seconds(period_) - load_);
+			if(load_ > 0.9f) quality_ = std::max(minQuality_, quality_ * 0.95f);
+			else if(load_ < 0.7f) quality_ = std::min(1.0f, quality_ + 0.01f);
+		}
+		
+	public:
+		FrameScheduler(f32 fps = 0.0f) {
+		#if defined(UTIL_WIN32)
+			timer_ = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		#endif
+			setTargetFps(fps);
+		}
+		~FrameScheduler() {
+		#if defined(UTIL_WIN32)
+			if(timer_) CloseHandle(timer_);
+		#endif
+		}
+		FrameScheduler(const FrameScheduler&) = delete;
+		FrameScheduler& operator=(const FrameScheduler&) = delete;
+		
+		void setTargetFps(f32 fps) {
+			period_ = fps > 0.0f ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<f64>(1.0 / fps)) : clock::duration::zero();
+			deadline_ = frameStart_;
+		}
+		f32 targetFps() const {return period_ == clock::duration::zero() ? 0.0f : (f32)(1.0 / seconds(period_));}
+		
+		// call once per frame before presenting it, returns the seconds since the last frame
+		f32 waitFrame() {
+			clock::time_point now = clock::now();
+			if(frames_ == 0) {
+				frameStart_ = deadline_ = now;
+				frames_++;
+				return 0.0f;
+			}
+			workTime_ = (f32)seconds(now - frameStart_);
 			
-			const std::string letterList =
-				"abcdefghijklmnopqrstuvwxyz"
-				"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-				"1234567890";
-				
-			for (u8 c : letterList) {
-				glyph_outline go = get_glyph_outline(&fontDir_, get_glyph_index(&fontDir_, static_cast<u8>(c)) );
-
-				// Cache transformed outline
-				glyphMap_[c] = deep_copy_glyph_outline(go);
+			if(period_ != clock::duration::zero()) {
+				deadline_ += period_;
+				if(now > deadline_) {
+					missed_++;
+					if(now - deadline_ > period_) deadline_ = now;
+				}
+				else preciseWait(deadline_);
+				if(adaptive_) adapt();
 			}
 			
-			std::cout<< "font loaded\n";
+			now = clock::now();
+			frameTime_ = (f32)seconds(now - frameStart_);
+			frameStart_ = now;
+			frames_++;
+			return frameTime_;
 		}
 		
-		void drawLetter(i32 cc, Point2D pos, i16 fontSize, Point2D wp) {
-			u8 c = static_cast<u8>(cc);
-			
-			if(glyphMap_.find(c) == glyphMap_.end()){
-				// std::cout << "letter not found\n";
-				return;
+		// for waitEvents, -1 without a target
+		i32 msUntilNextFrame() const {
+			if(period_ == clock::duration::zero() || frames_ == 0) return -1;
+			clock::duration left = deadline_ + period_ - clock::now();
+			return left <= clock::duration::zero() ? 0 : (i32)std::chrono::duration_cast<std::chrono::milliseconds>(left).count();
+		}
+		
+		// quality drifts down to minQuality while frames use up most of their period and climbs
+		// back to 1 once they don't, the app decides what to scale with it
+		void setAdaptiveQuality(bool enabled, f32 minQuality = 0.5f) {
+			adaptive_ = enabled;
+			minQuality_ = std::min(std::max(minQuality, 0.0f), 1.0f);
+			if(!enabled) quality_ = 1.0f;
+			load_ = 0.0f;
+		}
+		f32 quality() const {return quality_;}
+		
+		u32 frameCount() const {return frames_;}
+		u32 missedFrames() const {return missed_;}
+		f32 frameTime() const {return frameTime_;}
+		f32 workTime() const {return workTime_;}
+		void resetStats() {missed_ = 0;}
+	};
+	
+	class Window_common {
+	public:
+		i32 width;
+		i32 height;
+		i32 posX = 0;
+		i32 posY = 0;
+		const i8* name;
+		Raster r = Raster(0,0);
+		
+		i32 getWidht() {return width;}
+		i32 getHeight() {return height;}
+		i32 getPosX() {return posX;}
+		i32 getPosY() {return posY;}
+		
+	//font logic
+		// the face text gets drawn with, hand the same face to several windows to share
+		// its caches
+		std::shared_ptr<FontFace> font_;
+		std::shared_future<std::shared_ptr<FontFace>> pendingFont_;
+		
+		void setFont(std::shared_ptr<FontFace> face) {font_ = std::move(face);}
+		std::shared_ptr<FontFace> font() const {return font_;}
+		
+		FontFace& face() {
+			if(!font_) font_ = std::make_shared<FontFace>();
+			return *font_;
+		}
+		
+		bool loadFont(const i8* path) {return loadFont(path, nullptr);}
+		
+		// a face other windows still use is left alone, this window gets a new one set up the
+		// same way. an async load that is still running gets dropped, its worker finishes on its own
+		bool loadFont(const i8* path, const i8* cachePath) {
+			pendingFont_ = std::shared_future<std::shared_ptr<FontFace>>();
+			if(font_.use_count() > 1) {
+				std::shared_ptr<FontFace> face = std::make_shared<FontFace>();
+				face->configureLike(*font_);
+				font_ = face;
 			}
-			if(c >= 'a') {
-				fontSize = fontSize * 0.80;
+			return face().loadFont(path, cachePath);
+		}
+		
+		// returns right away and loads on a worker thread, until the face is ready text keeps
+		// being drawn with the current one, or not at all without one
+		void loadFontAsync(const i8* path, const i8* cachePath = nullptr) {
+			pendingFont_ = FontFace::loadAsync(path, cachePath, font_.get());
+		}
+		
+		// swaps in a finished async load, true while one is still running. fonts that fail
+		// to load leave the current face in place
+		bool fontPending() {
+			if(!pendingFont_.valid()) return false;
+			if(pendingFont_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return true;
+			std::shared_ptr<FontFace> face;
+			try {
+				face = pendingFont_.get();
+			} catch(...) {
+				// the worker threw (out of memory, say), same as a font that did not load
 			}
-			
-			Floint2D temp_points[512] = {Floint2D(0,0)};
-			
-			f32 scale = (f32)fontSize/(f32)(glyphMap_[c].yMax - glyphMap_[c].yMin);
-			
-			i32 index = 0;
-			i32 *contour_end_pts = (i32 *) malloc(sizeof(i32)*glyphMap_[c].numberOfContours);
-			generate_points(&glyphMap_[c], temp_points, &index, contour_end_pts);
-			
-			for(int i = 0; i < index; i++) {
-				temp_points[i].x = (temp_points[i].x  - glyphMap_[c].xMin)*scale;
-				temp_points[i].y = (temp_points[i].y  - glyphMap_[c].yMin)*scale;
+			pendingFont_ = std::shared_future<std::shared_ptr<FontFace>>();
+			if(face && face->isLoaded()) {
+				// settings changed while it was loading
+				if(font_) face->configureLike(*font_);
+				font_ = face;
 			}
+			return false;
+		}
+		
+		void setGlyphCacheBudget(size_t bytes) {face().setGlyphCacheBudget(bytes);}
+		void setGlyphRasterizer(GLYPH_RASTERIZER rasterizer) {face().setGlyphRasterizer(rasterizer);}
+		void setSubpixelText(bool enabled) {face().setSubpixelText(enabled);}
+		void setTextGamma(f32 gamma) {face().setTextGamma(gamma);}
+		void setFlattenTolerance(f32 pixels) {face().setFlattenTolerance(pixels);}
+		void setSdfResolution(i16 pixelsPerEm, f32 spread) {face().setSdfResolution(pixelsPerEm, spread);}
+		void preloadGlyphs(u32 first, u32 last) {face().preloadGlyphs(first, last);}
+		bool writeFontCache(const i8* path, u32 first, u32 last, const i16* sizes, i32 sizeCount) {
+			return face().writeFontCache(path, first, last, sizes, sizeCount);
+		}
+		
+		// pos is the pen position on the baseline
+		void drawLetter(i32 cc, Point2D pos, i16 fontSize, Point2D wp, Color color) {
+			fontPending();
+			if(font_) font_->drawGlyph(r, static_cast<u32>(cc), Point2D(wp.x + pos.x, wp.y + pos.y), fontSize, color);
+		}void drawLetter(i32 cc, Point2D pos, i16 fontSize, Point2D wp) {drawLetter(cc, pos, fontSize, wp, Color(0,0,0));}
+		
+		void drawText(const i8* utf8, Point2D pos, i16 size, Color color) {
+			fontPending();
+			if(font_) font_->drawText(r, utf8, pos, size, color);
+		}
+		i32 measureText(const i8* utf8, i16 size) {
+			fontPending();
+			return font_ ? font_->measureText(utf8, size) : 0;
+		}
+		void prepareText(const i8* utf8, i16 size) {
+			fontPending();
+			if(font_) font_->prepareText(utf8, size);
+		}
+		
+		void draw(TextLabel& label, Point2D pos) {label.draw(r, pos);}
+		
+	//event logic
+		// translated events on their way from the backend to handleEvents
+		EventRing<Event, 256> events_;
+		
+		// every pointer position that got folded away, for apps that want the whole path
+		bool keepMotionHistory_ = false;
+		// backends that fold moves before they reach the ring record them there, the others
+		// push every move and leave it to popEvents
+		bool recordMotionOnPop_ = true;
+		std::vector<pointer_sample> motionHistory_;
+		static const size_t motionHistoryLimit = 8192;
+		
+		void setMotionHistory(bool keep) {
+			keepMotionHistory_ = keep;
+			if(keep) motionHistory_.reserve(motionHistoryLimit);
+			else motionHistory_.clear();
+		}
+		// samples in arrival order since the last clear, the oldest half goes when it fills up
+		const std::vector<pointer_sample>& motionHistory() const {return motionHistory_;}
+		void clearMotionHistory() {motionHistory_.clear();}
+		
+		void recordMotion(const Event& e) {
+			if(!keepMotionHistory_) return;
+			if(motionHistory_.size() >= motionHistoryLimit)
+				motionHistory_.erase(motionHistory_.begin(), motionHistory_.begin() + motionHistoryLimit / 2);
+			pointer_sample sample = {e.mouseX, e.mouseY, e.time};
+			motionHistory_.push_back(sample);
+		}
+		
+		// folds later into e, both of the same type
+		static void foldEvent(Event& e, const Event& later) {
+			u32 moves = e.motionCount + later.motionCount;
+			e = later;
+			e.motionCount = moves;
+		}
+		
+		// pops up to max events. only the final size of a resize matters, so a resize is
+		// dropped when another one follows in the same batch. back to back pointer moves
+		// become one move to the last position. resizes and moves still queued right
+		// behind the batch get folded into its last event
+		u32 popEvents(Event* out, u32 max) {
+			u32 count = events_.pop(out, max);
+			if(count == 0) return 0;
+			if(recordMotionOnPop_) for(u32 i = 0; i < count; i++) if(out[i].type == EV_MOUSE_MOVE) recordMotion(out[i]);
 			
-			//lines
-			i32 edge_count = 0;
-			Line2D* edges = generate_edges(temp_points, &edge_count, contour_end_pts, glyphMap_[c].numberOfContours);
-			
-			u8 temp_texture[fontSize*fontSize] = {0};
-			
-			rasterize_glyph(edges, edge_count, temp_texture,fontSize,fontSize);
+			Event next;
+			while((out[count - 1].type == EV_RESIZE || out[count - 1].type == EV_MOUSE_MOVE) &&
+				  events_.peek(&next) && next.type == out[count - 1].type) {
+				events_.pop(&next);
+				if(next.type == EV_MOUSE_MOVE && recordMotionOnPop_) recordMotion(next);
+				foldEvent(out[count - 1], next);
+			}
 			
-			for (int j = 0; j < fontSize; j++) {
-				for (int i = 0; i < fontSize; i++) {
-					if(temp_texture[j*fontSize+i] >  0)
-						r.setColor(wp.x+pos.x+i, wp.y+pos.y-j ,
-									0-temp_texture[j*fontSize+i], 0-temp_texture[j*fontSize+i], 0-temp_texture[j*fontSize+i]);
+			i32 last = -1;
+			for(u32 i = 0; i < count; i++) if(out[i].type == EV_RESIZE) last = (i32)i;
+			u32 kept = 0;
+			for(u32 i = 0; i < count; i++) {
+				if(out[i].type == EV_RESIZE && (i32)i != last) continue;
+				if(out[i].type == EV_MOUSE_MOVE && kept > 0 && out[kept - 1].type == EV_MOUSE_MOVE) {
+					foldEvent(out[kept - 1], out[i]);
+					continue;
 				}
+				out[kept++] = out[i];
 			}
-			free(edges);
-			free(contour_end_pts);
+			return kept;
 		}
 		
+	//frame logic
+		// display() waits on it before presenting, unlimited until a target is set
+		FrameScheduler frames_;
+		
+		void setTargetFps(f32 fps) {frames_.setTargetFps(fps);}
+		FrameScheduler& frames() {return frames_;}
+		
 	//draw logic
 
 		void clear() { r.clear();}
@@ -1130,6 +4253,13 @@
 		void fillTriangle(Triangle2D t, Color c) {fillTriangle(t.p0.x, t.p0.y, t.p1.x, t.p1.y, t.p2.x, t.p2.y, c);}
 		void fillTriangle(Triangle2D t) {fillTriangle(t.p0.x, t.p0.y, t.p1.x, t.p1.y, t.p2.x, t.p2.y, Color(255,0,0));}
 		
+		void draw(const PointBuffer2D& pts, Color c) {r.drawPoints(pts, c);}
+		void draw(const PointBuffer2D& pts) {draw(pts, Color(255,0,0));}
+		void drawLineStrip(const PointBuffer2D& pts, Color c) {r.drawLineStrip(pts, c);}
+		void drawLineStrip(const PointBuffer2D& pts) {drawLineStrip(pts, Color(255,0,0));}
+		void fillTriangles(const PointBuffer2D& pts, Color c) {r.fillTriangles(pts, c);}
+		void fillTriangles(const PointBuffer2D& pts) {fillTriangles(pts, Color(255,0,0));}
+		
 		void parallelMemcpy(void* dst, const void* src, size_t size) {
 			i32 numThreads = std::thread::hardware_concurrency();
 			if (numThreads <= 0) numThreads = 4;
@@ -1157,27 +4287,6 @@
 	#ifdef MPWS_WIN32
 		#include <windows.h>
 		#include <Windowsx.h>//for mouse
-		
-		#include <queue>
-		#include <mutex>
-
-		enum CustomEventType {
-			CE_NONE,
-			CE_KEY_DOWN,
-			CE_KEY_UP,
-			CE_MOVE,
-			CE_RESIZE,
-			CE_CLOSE
-		};
-		
-		struct CustomEvent {
-			CustomEventType type;
-			union {
-				struct { i32 width, height; } resize;
-				struct { i32 keycode; } key;
-				struct { i32 x, y; } move;
-			};
-		};
 
 		EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 		HINSTANCE get_hinstance(void) {
@@ -1200,8 +4309,6 @@
 			HBITMAP hBuffer;
 			
 			std::thread update;
-			std::queue<CustomEvent> customEventQueue;
-			std::mutex queueMutex;
 			
 			
 			void create_W32_WindowClass(void);
@@ -1211,10 +4318,26 @@
 			
 			std::thread renderThread;
 			std::atomic<bool> renderAgain;
+			std::mutex blitLock;
+			std::condition_variable blitDone; // renderAgain went back to true
+			void waitForBlit();
+			
+			HANDLE wakeEvent; // set when the ring gets something or wake() is called
+			
+			// message thread only. events a full ring could not take yet, in order, published
+			// ahead of anything newer. runs of moves and resizes fold into their last entry
+			std::vector<Event> overflow_;
+			std::atomic<bool> overflowing_;
+			std::atomic<bool> destroying_; // nobody drains the ring anymore
+			static const UINT flushMessage = WM_APP + 1; // posted by handleEvents once it made room
+			void flushOverflow();
 			
 			void setupMPWS_WINDOW();
-			void pushEvent(const CustomEvent& event);
+			void pushEvent(const Event& event);
+			void applyEvent(const Event& event);
 			KeyCharacter translateInput(i32 vk);
+			Event pointerEvent(EventType type, WPARAM keys, LPARAM position);
+			static MouseButton translateButton(UINT msg, WPARAM wParam);
 			
 			std::atomic<bool> isLogicRunning;
 			void setUp(i32 w, i32 h, const char* n) {
@@ -1224,6 +4347,9 @@
 				isRunning = true;
 				isLogicRunning = true;
 				renderAgain.store(true);
+				overflowing_ = false;
+				destroying_ = false;
+				wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
 				
 				update = std::thread([this]() {
 					setupMPWS_WINDOW();
@@ -1233,8 +4359,11 @@
 						TranslateMessage(&msg);
 						DispatchMessage(&msg);
 						if(!isLogicRunning)
-							return;
+							break;
 					}
+					// the window is gone, nothing can hang anymore. EV_CLOSE may still be waiting
+					// for room, it gets there once the app drains or the window is destroyed
+					for(flushOverflow(); overflowing_ && !destroying_; flushOverflow()) Sleep(1);
 				});
 			}
 			
@@ -1252,13 +4381,19 @@
 			}
 			
 			~MPWS_WINDOW() {
+				destroying_ = true;
 				renderThread.join();
 				update.join();
+				waitForBlit();
+				CloseHandle(wakeEvent);
 			};
 			
 			void display();
 			
 			bool handleEvents(Event* event);
+			u32 handleEvents(Event* events, u32 max);
+			bool waitEvents(i32 timeoutMs = -1);
+			void wake();
 			
 			bool isOpen() {return isRunning;}
 		};
@@ -1266,6 +4401,8 @@
 		
 		
 		void MPWS_WINDOW::resize(i32 nw, i32 nh) {
+			// a blit in flight still copies into the old section and blits from its dc
+			waitForBlit();
 			r.resize(nw, nh);
 			setupBuffer();
 		}
@@ -1293,18 +4430,30 @@
 			
 		}
 		
+		void MPWS_WINDOW::waitForBlit() {
+			std::unique_lock<std::mutex> lock(blitLock);
+			blitDone.wait(lock, [this]{return renderAgain.load();});
+		}
+		
 		void MPWS_WINDOW::display() {
 			if(globalClass.className == NULL || !isRunning) return;
 			
-			while(!renderAgain) {std::this_thread::sleep_for(std::chrono::milliseconds(1));}
+			waitForBlit();
+			frames_.waitFrame();
 			
 			renderAgain.store(false);
+			// width and height follow events the app thread applies meanwhile, the blit
+			// takes the size of the section it copies into
+			i32 blitW = bmi.bmiHeader.biWidth, blitH = -bmi.bmiHeader.biHeight;
 			std::thread([=]{
 				this->parallelMemcpy(pBits, r.getRaster(), r.size());
 				HDC hdcLocal = GetDC(hwnd);
-				BitBlt(hdcLocal, 0, 0, width, height, memDC, 0, 0, SRCCOPY);
+				BitBlt(hdcLocal, 0, 0, blitW, blitH, memDC, 0, 0, SRCCOPY);
 				ReleaseDC(hwnd, hdcLocal);
+				// notified under the lock, the window may be gone once it is released
+				std::lock_guard<std::mutex> lock(blitLock);
 				renderAgain.store(true);
+				blitDone.notify_all();
 			}).detach();
 		}
 		
@@ -1356,9 +4505,69 @@
 			UpdateWindow(hwnd);
 		}
 		
-		void MPWS_WINDOW::pushEvent(const CustomEvent& ev) {
-			std::lock_guard<std::mutex> lock(queueMutex);
-			customEventQueue.push(ev);
+		// runs on the message thread, never waits on the app and never loses an event. once
+		// the ring is full events line up in overflow_ until handleEvents made room
+		void MPWS_WINDOW::pushEvent(const Event& ev) {
+			if(overflow_.empty() && events_.free() > 0) {
+				events_.push(ev);
+			} else {
+				bool foldable = ev.type == EV_MOVE || ev.type == EV_RESIZE || ev.type == EV_MOUSE_MOVE;
+				if(foldable && !overflow_.empty() && overflow_.back().type == ev.type) foldEvent(overflow_.back(), ev);
+				else overflow_.push_back(ev);
+				flushOverflow();
+			}
+			SetEvent(wakeEvent);
+		}
+		
+		void MPWS_WINDOW::flushOverflow() {
+			size_t sent = 0;
+			for(;;) {
+				while(sent < overflow_.size() && events_.free() > 0) events_.push(overflow_[sent++]);
+				overflowing_.store(sent < overflow_.size());
+				// handleEvents may have made room just before it could see the flag, look again
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if(sent == overflow_.size() || events_.free() == 0) break;
+			}
+			overflow_.erase(overflow_.begin(), overflow_.begin() + sent);
+			if(sent) SetEvent(wakeEvent);
+		}
+		
+		// blocks until the message thread queues an event, wake() gets called or the timeout
+		// runs out. true unless it timed out, the events are then taken with handleEvents
+		bool MPWS_WINDOW::waitEvents(i32 timeoutMs) {
+			if(globalClass.className == NULL || !isRunning) return false;
+			if(!events_.empty()) return true;
+			return WaitForSingleObject(wakeEvent, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs) == WAIT_OBJECT_0;
+		}
+		
+		// safe from any thread, e.g. to get a redraw going after a worker finished
+		void MPWS_WINDOW::wake() {
+			SetEvent(wakeEvent);
+		}
+		
+		Event MPWS_WINDOW::pointerEvent(EventType type, WPARAM keys, LPARAM position) {
+			Event ev = {};
+			ev.type = type;
+			ev.mouseX = GET_X_LPARAM(position);
+			ev.mouseY = GET_Y_LPARAM(position);
+			ev.time = (u32)GetMessageTime();
+			ev.modifiers =
+				((keys & MK_SHIFT)   ? 1 : 0) |
+				((keys & MK_CONTROL) ? 2 : 0) |
+				(GetKeyState(VK_MENU) < 0 ? 4 : 0) |
+				((GetKeyState(VK_CAPITAL) & 0x0001) ? 8 : 0);
+			return ev;
+		}
+		
+		MouseButton MPWS_WINDOW::translateButton(UINT msg, WPARAM wParam) {
+			switch(msg) {
+				case WM_LBUTTONDOWN: case WM_LBUTTONUP: return Mouse_LEFT;
+				case WM_MBUTTONDOWN: case WM_MBUTTONUP: return Mouse_MIDDLE;
+				case WM_RBUTTONDOWN: case WM_RBUTTONUP: return Mouse_RIGHT;
+				case WM_XBUTTONDOWN: case WM_XBUTTONUP:
+					return GET_XBUTTON_WPARAM(wParam) == XBUTTON1 ? Mouse_X1 : Mouse_X2;
+				default: return MOUSE_UNKNOWN;
+			}
 		}
 		
 		LRESULT CALLBACK MPWS_WINDOW::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -1373,20 +4582,20 @@
 				}
 				case WM_SIZE: {
 					if(w) {
-						CustomEvent ev;
-						ev.type = CE_RESIZE;
-						ev.resize.width = LOWORD(lParam);
-						ev.resize.height = HIWORD(lParam);
+						Event ev = {};
+						ev.type = EV_RESIZE;
+						ev.resizeWidth = LOWORD(lParam);
+						ev.resizeHeight = HIWORD(lParam);
 						w->pushEvent(ev);
 					}
 					return 0;
 				}
 				case WM_MOVE: {
 					if(w) {
-						CustomEvent ev;
-						ev.type = CE_MOVE;
-						ev.move.x = LOWORD(lParam);
-						ev.move.y = HIWORD(lParam);
+						Event ev = {};
+						ev.type = EV_MOVE;
+						ev.moveX = (i16)LOWORD(lParam);
+						ev.moveY = (i16)HIWORD(lParam);
 						w->pushEvent(ev);
 					}
 					return 0;
@@ -1394,9 +4603,15 @@
 				case WM_KEYDOWN:
 				case WM_SYSKEYDOWN: {
 					if(w) {
-						CustomEvent ev;
-						ev.type = CE_KEY_DOWN;
-						ev.key.keycode = (i32)wParam;
+						// key state belongs to the thread that owns the window, read it here
+						Event ev = {};
+						ev.type = EV_KEY_DOWN;
+						ev.keycode = w->translateInput((i32)wParam);
+						ev.modifiers =
+							(GetKeyState(VK_SHIFT)   < 0 ?1:0) |
+							(GetKeyState(VK_CONTROL) < 0 ?2:0) |
+							(GetKeyState(VK_MENU)    < 0 ?4:0) |
+							((GetKeyState(VK_CAPITAL) & 0x0001) ? 8:0);
 						w->pushEvent(ev);
 					}
 					return 0;	
@@ -1404,20 +4619,71 @@
 				case WM_KEYUP:
 				case WM_SYSKEYUP: {
 					if(w) {
-						CustomEvent ev;
-						ev.type = CE_KEY_UP;
-						ev.key.keycode = (i32)wParam;
+						Event ev = {};
+						ev.type = EV_KEY_UP;
+						ev.keycode = w->translateInput((i32)wParam);
+						ev.modifiers = 0;
 						w->pushEvent(ev);
 					}
 					return 0;	
 				}
+				case WM_MOUSEMOVE: {
+					if(w) {
+						Event ev = w->pointerEvent(EV_MOUSE_MOVE, wParam, lParam);
+						ev.motionCount = 1;
+						w->pushEvent(ev);
+					}
+					return 0;
+				}
+				case WM_LBUTTONDOWN:
+				case WM_MBUTTONDOWN:
+				case WM_RBUTTONDOWN:
+				case WM_XBUTTONDOWN: {
+					if(w) {
+						// keeps the matching up coming when the pointer leaves the window
+						SetCapture(hwnd);
+						Event ev = w->pointerEvent(EV_MOUSE_DOWN, wParam, lParam);
+						ev.button = translateButton(uMsg, wParam);
+						w->pushEvent(ev);
+					}
+					return uMsg == WM_XBUTTONDOWN ? TRUE : 0;
+				}
+				case WM_LBUTTONUP:
+				case WM_MBUTTONUP:
+				case WM_RBUTTONUP:
+				case WM_XBUTTONUP: {
+					if(w) {
+						if((wParam & (MK_LBUTTON | MK_MBUTTON | MK_RBUTTON | MK_XBUTTON1 | MK_XBUTTON2)) == 0) ReleaseCapture();
+						Event ev = w->pointerEvent(EV_MOUSE_UP, wParam, lParam);
+						ev.button = translateButton(uMsg, wParam);
+						w->pushEvent(ev);
+					}
+					return uMsg == WM_XBUTTONUP ? TRUE : 0;
+				}
+				case WM_MOUSEWHEEL:
+				case WM_MOUSEHWHEEL: {
+					if(w) {
+						// wheel messages come in screen coordinates
+						POINT p = {GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+						ScreenToClient(hwnd, &p);
+						Event ev = w->pointerEvent(EV_MOUSE_WHEEL, GET_KEYSTATE_WPARAM(wParam), MAKELPARAM(p.x, p.y));
+						f32 notches = (f32)GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA;
+						if(uMsg == WM_MOUSEWHEEL) ev.wheelY = notches;
+						else ev.wheelX = notches;
+						w->pushEvent(ev);
+					}
+					return 0;
+				}
 				case WM_ERASEBKGND:
 					return 1;
+				case flushMessage:
+					if(w) w->flushOverflow();
+					return 0;
 				case WM_CLOSE:
 				case WM_DESTROY: {
 					if(w) {
-						CustomEvent ev;
-						ev.type = CE_CLOSE;
+						Event ev = {};
+						ev.type = EV_CLOSE;
 						
 						w->pushEvent(ev);
 						w->isLogicRunning = false;
@@ -1431,68 +4697,37 @@
 			return DefWindowProc(hwnd, uMsg, wParam, lParam);
 		}
 		
-		bool MPWS_WINDOW::handleEvents(Event* event) {
-			if(globalClass.className == NULL || !isRunning) return false;
+		bool MPWS_WINDOW::handleEvents(Event* event) {return handleEvents(event, 1) == 1;}
+		
+		// pops a batch of what the message thread queued and applies it to the window
+		u32 MPWS_WINDOW::handleEvents(Event* events, u32 max) {
+			if(globalClass.className == NULL || !isRunning) return 0;
 			
-			{
-				std::lock_guard<std::mutex> lock(queueMutex);
-				if (customEventQueue.empty()) return false;
-
-				//TODO: while resize should happen once, move should give continous updates
-				CustomEvent ev = customEventQueue.front();
-				customEventQueue.pop();
-				//remove duplicate resize calls
-				if(ev.type == CE_RESIZE) {
-					CustomEvent nextEvent = customEventQueue.front();
-					while(nextEvent.type == CE_RESIZE && !customEventQueue.empty()) {
-						ev = nextEvent;
-						customEventQueue.pop();
-						nextEvent = customEventQueue.front();
-					}
-				}
-
-				switch (ev.type) {
-				case CE_KEY_DOWN:
-					event->type = EV_KEY_DOWN;
-					event->keycode = translateInput(ev.key.keycode);
-					event->modifiers = 
-						(GetKeyState(VK_SHIFT)   < 0 ?1:0) |
-						(GetKeyState(VK_CONTROL) < 0 ?2:0) |
-						(GetKeyState(VK_MENU)    < 0 ?4:0) |
-						((GetKeyState(VK_CAPITAL) & 0x0001) ? 8:0);
-					return true;
-				case CE_KEY_UP:
-					event->type     = EV_KEY_UP;
-					event->keycode  = translateInput(ev.key.keycode);
-					event->modifiers = 0;
-					return true;
-				case CE_MOVE:
-					event->type = EV_MOVE;
-					event->moveX = ev.move.x;
-					event->moveY = ev.move.y;
-					posX = event->moveX;
-					posY = event->moveY;
-					return true;
-				case CE_RESIZE:
-					event->type = EV_RESIZE;
-					event->resizeWidth = ev.resize.width;
-					event->resizeHeight = ev.resize.height;
-					width = event->resizeWidth;
-					height = event->resizeHeight;
-					resize(width,height);
-					return true;
-				case CE_CLOSE:
-					event->type = EV_CLOSE;
-					isRunning = false;
-					// update.join();
-					// std::cout << "Window Closed";
-					return true;
-				default:
-					return false;
-				}
+			u32 count = popEvents(events, max);
+			// pairs with the fence in flushOverflow, one of the two sides sees the room
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(count && overflowing_) PostMessage(hwnd, flushMessage, 0, 0);
+			for(u32 i = 0; i < count; i++) applyEvent(events[i]);
+			return count;
+		}
+		
+		void MPWS_WINDOW::applyEvent(const Event& ev) {
+			switch (ev.type) {
+			case EV_MOVE:
+				posX = ev.moveX;
+				posY = ev.moveY;
+				break;
+			case EV_RESIZE:
+				width = ev.resizeWidth;
+				height = ev.resizeHeight;
+				resize(width,height);
+				break;
+			case EV_CLOSE:
+				isRunning = false;
+				break;
+			default:
+				break;
 			}
-			
-			return false;
 		}
 
 		KeyCharacter MPWS_WINDOW::translateInput(i32 vk) {
@@ -1592,7 +4827,11 @@
 		#else
 
 			#include <X11/Xlib.h>
+			#include <X11/Xutil.h>
 			#include <X11/keysym.h>
+			#include <poll.h>
+			#include <sys/eventfd.h>
+			#include <cerrno>
 
 			typedef struct {
 				Display* display;
@@ -1607,15 +4846,30 @@
 				GC gc;
 				XEvent event;
 				i32 screen;
-				XImage* image;
+				XImage* image = nullptr; // wraps the raster's pixels, never owns them
 
 				void resize(i32 nw, i32 nh);
 				void setupBuffer();
 				void setupMPWS_WINDOW();
 
 				std::atomic<bool> renderAgain;
+				std::mutex blitLock;
+				std::condition_variable blitDone; // renderAgain went back to true
+				void waitForBlit();
+
+				i32 wakeFd = -1; // eventfd polled next to the connection, written by wake()
+				i32 configX = 0, configY = 0; // last position and size the server reported
+				i32 configW = 0, configH = 0;
+				bool resizePending = false;   // width/height changed, the raster not yet
 
 				KeyCharacter translateInput(KeySym sym);
+				static i32 translateModifiers(u32 state);
+				void drainEvents();
+				void translateEvent(XEvent& xev);
+				void translateConfigure(const XConfigureEvent& c);
+				Event translateMotion(const XMotionEvent& m);
+				void applyEvent(const Event& event);
+				void flushResize();
 
 			public:
 				bool isRunning;
@@ -1638,12 +4892,20 @@
 
 				~MPWS_WINDOW() {
 					// XDestroyWindow(globalDisplay.display, window);
-					// XDestroyImage(image);
+					waitForBlit();
+					if(image) {
+						image->data = nullptr;
+						XDestroyImage(image);
+					}
+					if(wakeFd >= 0) close(wakeFd);
 				}
 
 				void display();
 
 				bool handleEvents(Event* event);
+				u32 handleEvents(Event* events, u32 max);
+				bool waitEvents(i32 timeoutMs = -1);
+				void wake();
 				
 				bool isOpen() {return isRunning;}
 			};
@@ -1652,6 +4914,9 @@
 
 			void MPWS_WINDOW::setupBuffer() {
 				if(image) {
+					// the pixels belong to the raster, XDestroyImage would free them too
+					image->data = nullptr;
+					XDestroyImage(image);
 					image = nullptr;
 				}
 				image = XCreateImage(globalDisplay.display,
@@ -1664,29 +4929,56 @@
 			}
 
 			void MPWS_WINDOW::resize(i32 nw, i32 nh) {
+				// a blit still in flight reads the old pixels
+				waitForBlit();
 				r.resize(nw,nh);
 				setupBuffer();
 			}
 
+			// the raster follows the window once per frame however many sizes a drag went through
+			void MPWS_WINDOW::flushResize() {
+				if(!resizePending) return;
+				resizePending = false;
+				resize(width,height);
+			}
+
+			void MPWS_WINDOW::waitForBlit() {
+				std::unique_lock<std::mutex> lock(blitLock);
+				blitDone.wait(lock, [this]{return renderAgain.load();});
+			}
+
 			void MPWS_WINDOW::display() {
 				if(!isRunning) return;
+				flushResize();
 
-				while(!renderAgain) {std::this_thread::sleep_for(std::chrono::milliseconds(1));}
+				waitForBlit();
+				frames_.waitFrame();
 				// image->data = reinterpret_cast<char*>(r.getRaster());
 				// XPutImage(globalDisplay.display, window, gc, image, 0, 0, 0, 0, width, height);
 				renderAgain.store(false);
+				// width and height follow events the app thread applies meanwhile, the blit
+				// takes the size of the image it puts
+				i32 blitW = image->width, blitH = image->height;
 				std::thread([=]{
-					// memcpy(pBits, r.getRaster(), r.size());
-					parallelMemcpy(image->data, r.getRaster(), r.size());
-
-					XPutImage(globalDisplay.display, window, gc, image, 0, 0, 0, 0, width, height);
+					// image->data is the raster itself, there is nothing to copy
+					XPutImage(globalDisplay.display, window, gc, image, 0, 0, 0, 0, blitW, blitH);
+					// the put may have read events into xlib's queue that a waitEvents already
+					// polling never sees on the socket, flush our side and let it look again
+					XFlush(globalDisplay.display);
+					wake();
 					
+					// notified under the lock, the window may be gone once it is released
+					std::lock_guard<std::mutex> lock(blitLock);
 					renderAgain.store(true);
+					blitDone.notify_all();
 				}).detach();
 			}
 
 			void MPWS_WINDOW::setupMPWS_WINDOW() {
 				if (globalDisplay.display == NULL) {
+					// display() puts the image from its blit thread while the app thread reads
+					// events off the same connection, xlib only locks it when asked to up front
+					XInitThreads();
 					globalDisplay.display = XOpenDisplay(NULL);
 					if (globalDisplay.display == NULL) {
 						std::cout << "Cannot open display\n";
@@ -1704,7 +4996,14 @@
 					WhitePixel(globalDisplay.display, screen)
 				);
 
-				XSelectInput(globalDisplay.display, window, StructureNotifyMask | ExposureMask | KeyPressMask | KeyReleaseMask | ButtonPressMask);
+				configW = width;
+				configH = height;
+				renderAgain.store(true);
+				recordMotionOnPop_ = false; // drainEvents records every sample it folds
+				wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+				XSelectInput(globalDisplay.display, window, StructureNotifyMask | ExposureMask | KeyPressMask | KeyReleaseMask |
+							 ButtonPressMask | ButtonReleaseMask | PointerMotionMask);
 
 				XMapWindow(globalDisplay.display, window);
 
@@ -1716,73 +5015,213 @@
 				XSetWMProtocols(globalDisplay.display, window, &wmDeleteMessage, 1);
 			}
 
-			bool MPWS_WINDOW::handleEvents(Event* event) {
+			bool MPWS_WINDOW::handleEvents(Event* event) {return handleEvents(event, 1) == 1;}
+
+			// blocks until the server sends something, wake() gets called or the timeout runs
+			// out. true unless it timed out, the events are then taken with handleEvents
+			bool MPWS_WINDOW::waitEvents(i32 timeoutMs) {
+				if(!isRunning) return false;
+				// xlib may hold events it already read off the socket, poll would not see them.
+				// XPending also flushes our requests before we go to sleep
+				if(!events_.empty() || XPending(globalDisplay.display) != 0) return true;
+
+				pollfd fds[2] = {
+					{ConnectionNumber(globalDisplay.display), POLLIN, 0},
+					{wakeFd, POLLIN, 0}
+				};
+				i32 ready;
+				do ready = poll(fds, wakeFd >= 0 ? 2 : 1, timeoutMs);
+				while(ready < 0 && errno == EINTR);
+				if(ready <= 0) return false;
+
+				if(fds[1].revents & POLLIN) {
+					eventfd_t wakes;
+					eventfd_read(wakeFd, &wakes);
+				}
+				return true;
+			}
+
+			// safe from any thread, e.g. to get a redraw going after a worker finished
+			void MPWS_WINDOW::wake() {
+				if(wakeFd >= 0) eventfd_write(wakeFd, 1);
+			}
+
+			// events are read off the connection on the app thread, right before the ring gets
+			// drained. once the ring runs dry the raster catches up with the last size
+			u32 MPWS_WINDOW::handleEvents(Event* events, u32 max) {
+				drainEvents();
 
-				if (XPending(globalDisplay.display) == 0)
-					return false;  // Nothing to process — return immediately
+				u32 count = popEvents(events, max);
+				for(u32 i = 0; i < count; i++) applyEvent(events[i]);
+				if(count < max) flushResize();
+				return count;
+			}
 
-				XEvent xev;
-				XNextEvent(globalDisplay.display, &xev);  // This removes the event from the queue
+			// takes everything the server sent so far. a run of configure notifies only counts
+			// with its last one and a run of motion notifies becomes one move carrying how many
+			// it stands for, so a fast mouse takes a single slot. anything else in between keeps
+			// its place in the order. an event takes up to two slots (a configure can become a
+			// move and a resize) and a held back one up to two more, whatever does not fit stays
+			// in xlib's queue
+			void MPWS_WINDOW::drainEvents() {
+				XConfigureEvent configure;
+				bool configurePending = false;
+				Event move = {};
+				bool movePending = false;
+				auto flush = [&]() {
+					if (configurePending) translateConfigure(configure);
+					if (movePending) events_.push(move);
+					configurePending = movePending = false;
+				};
+				while (events_.free() >= 2u + (configurePending ? 2u : movePending ? 1u : 0u) &&
+					   XPending(globalDisplay.display) != 0) {
+					XEvent xev;
+					XNextEvent(globalDisplay.display, &xev);  // This removes the event from the queue
+					if (xev.type == ConfigureNotify) {
+						if (movePending) flush();
+						configure = xev.xconfigure;
+						configurePending = true;
+						continue;
+					}
+					if (xev.type == MotionNotify) {
+						if (configurePending) flush();
+						Event sample = translateMotion(xev.xmotion);
+						recordMotion(sample);
+						if (movePending) foldEvent(move, sample);
+						else move = sample;
+						movePending = true;
+						continue;
+					}
+					flush();
+					translateEvent(xev);
+				}
+				flush();
+			}
 
+			void MPWS_WINDOW::translateEvent(XEvent& xev) {
+				Event ev = {};
 				switch (xev.type) {
 				case KeyPress:
-					event->type = EV_KEY_DOWN;
-					// event->keycode = xev.xkey.keycode;
-					event->keycode = translateInput(XLookupKeysym(&xev.xkey, 0));
-					event->modifiers = 
-					((xev.xkey.state & ShiftMask)   ? 1 : 0) |
-					((xev.xkey.state & ControlMask) ? 2 : 0) |
-					((xev.xkey.state & Mod1Mask)    ? 4 : 0) | // Alt (usually Mod1)
-					((xev.xkey.state & LockMask)    ? 8 : 0);
+					ev.type = EV_KEY_DOWN;
+					ev.keycode = translateInput(XLookupKeysym(&xev.xkey, 0));
+					ev.modifiers = translateModifiers(xev.xkey.state);
+					events_.push(ev);
 					break;
 				case KeyRelease:
-					event->type = EV_KEY_UP;
-					event->keycode = translateInput(XLookupKeysym(&xev.xkey, 0));
-					event->modifiers = 0;
+					ev.type = EV_KEY_UP;
+					ev.keycode = translateInput(XLookupKeysym(&xev.xkey, 0));
+					ev.modifiers = 0;
+					events_.push(ev);
+					break;
+				case ConfigureNotify:
+					translateConfigure(xev.xconfigure);
 					break;
-				case ConfigureNotify: {
-						i32 newX = xev.xconfigure.x;
-						i32 newY = xev.xconfigure.y;
-						i32 newW = xev.xconfigure.width;
-						i32 newH = xev.xconfigure.height;
-
-						bool moved = (newX != event->moveX) || (newY != event->moveY);
-						bool resized = (newW != event->resizeWidth) || (newH != event->resizeHeight);
-
-						if (moved) {
-							event->type = EV_MOVE;
-							event->moveX = newX;
-							event->moveY = newY;
-							posX = event->moveX;
-							posY = event->moveY;
+				case MotionNotify:
+					ev = translateMotion(xev.xmotion);
+					recordMotion(ev);
+					events_.push(ev);
+					break;
+				case ButtonPress:
+				case ButtonRelease: {
+						const XButtonEvent& b = xev.xbutton;
+						ev.mouseX = b.x;
+						ev.mouseY = b.y;
+						ev.modifiers = translateModifiers(b.state);
+						ev.time = (u32)b.time;
+						// the wheel arrives as presses of buttons 4 to 7, each one notch
+						if (b.button >= 4 && b.button <= 7) {
+							if (xev.type == ButtonRelease) break;
+							ev.type = EV_MOUSE_WHEEL;
+							ev.wheelY = b.button == 4 ? 1.0f : b.button == 5 ? -1.0f : 0.0f;
+							ev.wheelX = b.button == 7 ? 1.0f : b.button == 6 ? -1.0f : 0.0f;
+							events_.push(ev);
+							break;
 						}
-
-						if (resized) {
-							event->type = EV_RESIZE;
-							event->resizeWidth = newW;
-							event->resizeHeight = newH;
-							width = newW;
-							height = newH;
-							resize(width,height);
+						ev.type = xev.type == ButtonPress ? EV_MOUSE_DOWN : EV_MOUSE_UP;
+						switch (b.button) {
+							case Button1: ev.button = Mouse_LEFT; break;
+							case Button2: ev.button = Mouse_MIDDLE; break;
+							case Button3: ev.button = Mouse_RIGHT; break;
+							case 8: ev.button = Mouse_X1; break;
+							case 9: ev.button = Mouse_X2; break;
+							default: ev.button = MOUSE_UNKNOWN; break;
 						}
+						events_.push(ev);
 						break;
 					}
 				case ClientMessage:
 					if ((Atom)xev.xclient.data.l[0] == wmDeleteMessage) {
-						event->type = EV_CLOSE;
-						isRunning = false;
-						XDestroyWindow(globalDisplay.display, window);
-						break;
+						ev.type = EV_CLOSE;
+						events_.push(ev);
 					}
-				// fallthrough to default
+					break;
 				default:
-					// Dispatch unhandled events to the default handler
-					// or ignore them
-					// For X11, you might forward Expose/Resize/etc here
-					return false;
+					// Expose and the rest have no Event counterpart
+					break;
     			}
+			}
 
-				return true;
+			i32 MPWS_WINDOW::translateModifiers(u32 state) {
+				return ((state & ShiftMask)   ? 1 : 0) |
+					   ((state & ControlMask) ? 2 : 0) |
+					   ((state & Mod1Mask)    ? 4 : 0) | // Alt (usually Mod1)
+					   ((state & LockMask)    ? 8 : 0);
+			}
+
+			Event MPWS_WINDOW::translateMotion(const XMotionEvent& m) {
+				Event ev = {};
+				ev.type = EV_MOUSE_MOVE;
+				ev.mouseX = m.x;
+				ev.mouseY = m.y;
+				ev.modifiers = translateModifiers(m.state);
+				ev.motionCount = 1;
+				ev.time = (u32)m.time;
+				return ev;
+			}
+
+			void MPWS_WINDOW::translateConfigure(const XConfigureEvent& c) {
+				Event ev = {};
+				if (c.x != configX || c.y != configY) {
+					configX = c.x;
+					configY = c.y;
+					ev.type = EV_MOVE;
+					ev.moveX = c.x;
+					ev.moveY = c.y;
+					events_.push(ev);
+				}
+				if (c.width != configW || c.height != configH) {
+					configW = c.width;
+					configH = c.height;
+					ev.type = EV_RESIZE;
+					ev.resizeWidth = c.width;
+					ev.resizeHeight = c.height;
+					events_.push(ev);
+				}
+			}
+
+			void MPWS_WINDOW::applyEvent(const Event& ev) {
+				switch (ev.type) {
+				case EV_MOVE:
+					posX = ev.moveX;
+					posY = ev.moveY;
+					break;
+				case EV_RESIZE:
+					if (ev.resizeWidth == width && ev.resizeHeight == height) break;
+					width = ev.resizeWidth;
+					height = ev.resizeHeight;
+					resizePending = true;
+					break;
+				case EV_CLOSE:
+					if (!isRunning) break;
+					isRunning = false;
+					// drained events may still be queued behind the close, and a blit in
+					// flight still puts into the window
+					waitForBlit();
+					XDestroyWindow(globalDisplay.display, window);
+					break;
+				default:
+					break;
+				}
 			}
 
 			KeyCharacter MPWS_WINDOW::translateInput(KeySym sym) {